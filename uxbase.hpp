@@ -35,6 +35,7 @@ typedef unsigned char u_int8_t;
 #include <memory>
 #include <numeric>
 #include <optional>
+#include <queue>
 #include <random>
 #include <regex>
 #include <sstream>
@@ -63,7 +64,12 @@ OS SPECIFIC HEADERS
 #include <X11/keysym.h>
 #include <X11/keysymdef.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+#include <xcb/shm.h>
 #include <xcb/xcb_keysyms.h>
 
 #elif defined(_WIN64)
@@ -14,6 +14,9 @@
 using namespace std;
 using namespace uxdevice;
 
+thread_local uxdevice::platform::RECORDING uxdevice::platform::recording = {};
+thread_local uxdevice::platform::BATCH uxdevice::platform::batch = {};
+
 /**
 \internal
 \brief The routine is the main rendering thread. The thread runs
@@ -25,6 +28,23 @@ drawing cannot occur on the graphical while the surface is being resized.
 void uxdevice::platform::renderLoop(void) {
   while (bProcessing) {
 
+    // merge the recordings published by producers and release superseded
+    // parameter units, a slice per pass. published recordings are always
+    // merged, the lock is waited on for them. compaction alone only tries
+    // the lock so that the renderer does not wait on the api.
+    DrawingOutputBatch drawables = {};
+    if (!submissions.empty()) {
+      DL_SPIN;
+      mergeRecordings(drawables);
+      DL.compact(compactSlice);
+      DL_CLEAR;
+    } else if (DL_TRY) {
+      DL.compact(compactSlice);
+      DL_CLEAR;
+    }
+    if (!drawables.empty())
+      context.addDrawables(drawables);
+
     // surfacePrime checks to see if the surface exists.
     // if so, the two possible work flows are painting
     // background rectangles that are cause by the user resizing the
@@ -35,7 +55,9 @@ void uxdevice::platform::renderLoop(void) {
     // searches for unready and syncs display context
     // if no work exists  it waits on the cvRenderWork condition variable.
     if (context.surfacePrime()) {
+      paceFrame();
       context.render();
+      frameComplete();
     }
 
     if (context.errorState())
@@ -43,6 +65,101 @@ void uxdevice::platform::renderLoop(void) {
   }
 }
 
+/**
+\internal
+\brief The routine waits for the next tick of the frame clock. Damage
+submitted in the meantime accumulates and is rendered by the one frame.
+When the renderer was idle past the tick, the frame starts at once and
+the clock is aligned to it.
+*/
+void uxdevice::platform::paceFrame(void) {
+  auto now = std::chrono::steady_clock::now();
+  if (framesPerSecond && now < nextFrame) {
+    std::this_thread::sleep_until(nextFrame);
+    frameStart = nextFrame;
+  } else {
+    frameStart = now;
+  }
+}
+
+/**
+\internal
+\brief The routine accounts for the frame just rendered and schedules
+the next tick. A frame that took longer than the period is late, the
+ticks that passed while it rendered are counted as dropped and the next
+frame is placed on the following tick.
+*/
+void uxdevice::platform::frameComplete(void) {
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - frameStart);
+
+  frameCount++;
+  frameTimeTotal += elapsed.count();
+  frameTimeLast = elapsed.count();
+  culledLast = context.culledDraws.exchange(0);
+  culledTotal += culledLast;
+
+  int fps = framesPerSecond;
+  if (!fps) {
+    nextFrame = {};
+    return;
+  }
+
+  std::chrono::nanoseconds period(1000000000 / fps);
+  std::int64_t ticks = elapsed / period;
+  if (ticks) {
+    lateFrames++;
+    droppedFrames += ticks;
+  }
+  nextFrame = frameStart + period * (ticks + 1);
+}
+
+/**
+\brief returns the frame counters and times since the last reset.
+*/
+uxdevice::frameStats uxdevice::platform::stats(void) {
+  frameStats ret;
+  ret.frames = frameCount;
+  ret.late = lateFrames;
+  ret.dropped = droppedFrames;
+  ret.lastFrameTime = frameTimeLast / 1000000.0;
+  ret.culled = culledTotal;
+  ret.lastFrameCulled = culledLast;
+  if (ret.frames)
+    ret.averageFrameTime = frameTimeTotal / 1000000.0 / ret.frames;
+  return ret;
+}
+
+/**
+\brief clears the frame counters.
+*/
+void uxdevice::platform::resetStats(void) {
+  frameCount = 0;
+  lateFrames = 0;
+  droppedFrames = 0;
+  frameTimeTotal = 0;
+  frameTimeLast = 0;
+  culledTotal = 0;
+  culledLast = 0;
+}
+
+/**
+\brief scrolls the window to the document position x, y. Only the
+objects within the previous and the new viewport are visited.
+*/
+void uxdevice::platform::scroll(int x, int y) {
+  context.offsetPosition(x, y);
+  context.stateNotifyComplete();
+}
+
+/**
+\brief scrolls the window by the distance given.
+*/
+void uxdevice::platform::scrollBy(int dx, int dy) {
+  cairo_rectangle_int_t r = context.viewport();
+  scroll(r.x + dx, r.y + dy);
+}
+
 /*
 \brief the dispatch routine is invoked by the messageLoop.
 If default
@@ -111,7 +228,6 @@ void uxdevice::platform::startProcessing(void) {
   // setup the event dispatcher
   eventHandler ev = std::bind(&uxdevice::platform::dispatchEvent, this,
                               std::placeholders::_1);
-  context.cacheThreshold = 2000;
   std::thread thrRenderer([=]() {
     bProcessing = true;
     renderLoop();
@@ -197,6 +313,7 @@ void uxdevice::platform::dispatch(const event &e) {
 uxdevice::platform::platform(const eventHandler &evtDispatcher,
                              const errorHandler &fn)
     : fnError(fn), fnEvents(evtDispatcher) {
+  context.submissions = &submissions;
 
 // initialize private members
 #if defined(__linux__)
@@ -283,7 +400,9 @@ void uxdevice::platform::openWindow(const std::string &sWindowTitle,
   context.window = context.screen->root;
   context.graphics = xcb_generate_id(context.connection);
   uint32_t mask = XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES;
-  uint32_t values[] = {context.screen->black_pixel, 0};
+  // exposures report the areas a scroll could not copy as the window
+  // was obscured.
+  uint32_t values[] = {context.screen->black_pixel, 1};
   xcb_create_gc(context.connection, context.graphics, context.window, mask,
                 values);
 
@@ -357,15 +476,18 @@ void uxdevice::platform::openWindow(const std::string &sWindowTitle,
     throw std::runtime_error(sError.str());
   }
 
-  // create cairo context
-  context.cr = cairo_create(context.xcbSurface);
-  if (!context.cr) {
+  // create cairo context of the window, objects draw into the back
+  // buffer which is copied to the window.
+  context.windowCr = cairo_create(context.xcbSurface);
+  context.allocateBackBuffer(context.windowWidth, context.windowHeight);
+  if (!context.windowCr || !context.cr) {
     closeWindow();
     std::stringstream sError;
     sError << "ERR_CAIRO "
            << "  " << __FILE__ << " " << __func__;
     throw std::runtime_error(sError.str());
   }
+  context.selectBacking();
 
   /* Map the window on the screen and flush*/
   xcb_map_window(context.connection, context.window);
@@ -464,9 +586,10 @@ void uxdevice::platform::closeWindow(void) {
     cairo_surface_destroy(context.xcbSurface);
     context.xcbSurface = nullptr;
   }
-  if (context.cr) {
-    cairo_destroy(context.cr);
-    context.cr = nullptr;
+  context.releaseBackBuffer();
+  if (context.windowCr) {
+    cairo_destroy(context.windowCr);
+    context.windowCr = nullptr;
   }
   if (context.graphics) {
     xcb_free_gc(context.connection, context.graphics);
@@ -722,6 +845,14 @@ void uxdevice::platform::messageLoop(void) {
         dispatchEvent(event{eventType::paint, (short)eev->x, (short)eev->y,
                             (short)eev->width, (short)eev->height});
 
+      } break;
+      case XCB_GRAPHICS_EXPOSURE: {
+        xcb_graphics_exposure_event_t *gev =
+            (xcb_graphics_exposure_event_t *)xcbEvent;
+
+        dispatchEvent(event{eventType::paint, (short)gev->x, (short)gev->y,
+                            (short)gev->width, (short)gev->height});
+
       } break;
       case XCB_CONFIGURE_NOTIFY: {
         const xcb_configure_notify_event_t *cfgEvent =
@@ -766,390 +897,413 @@ display list to not get in the way of the rendering loop,
 
 void uxdevice::platform::clear(void) {
   DL_SPIN;
+  // recordings published before the clear are discarded.
+  while (submissions.pop())
+    ;
   context.clear();
+  commands.reset();
   DL.clear();
   DL_CLEAR;
-}
-void uxdevice::platform::notifyComplete(void) { context.stateNotifyComplete(); }
 
-void uxdevice::platform::antiAlias(antialias antialias) {
+  if (batching()) {
+    batch.commands.reset();
+    batch.units.clear();
+  }
+}
+void uxdevice::platform::notifyComplete(void) {
   DL_SPIN;
-  auto item = DL.emplace_back(make_shared<ANTIALIAS>(antialias));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<ANTIALIAS>(item));
+  closeCommands(commands);
   DL_CLEAR;
+  context.diffComplete();
+  context.stateNotifyComplete();
 }
 
 /**
-\brief sets the text
+\brief opens a batch on the calling thread. Subsequent api calls from
+this thread collect their units without taking the display list lock.
+Each thread has its own batch, batches opened by other threads are not
+affected. The units are applied to the context when the batch is
+committed, drawables returned during a batch are built then. If the
+thread already has a batch open the calls join it.
 */
-void uxdevice::platform::text(const std::string &s) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<STRING>(s));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<STRING>(item));
-  DL_CLEAR;
+void uxdevice::platform::beginBatch(void) {
+  if (batch.owner)
+    return;
+
+  batch.owner = this;
+  batch.units.account(DL);
 }
+
 /**
-\brief
+\brief publishes the open batch. The units are applied to the context in
+order and moved to the display list under one acquisition of the lock,
+the drawables are partitioned at once and the renderer is notified a
+single time.
 */
-void uxdevice::platform::text(const std::stringstream &s) {
+void uxdevice::platform::commit(void) {
+  if (!batching())
+    return;
+
+  DrawingOutputBatch drawables = {};
+  batch.commands.reset();
+  batch.owner = nullptr;
+
   DL_SPIN;
-  auto item = DL.emplace_back(make_shared<STRING>(s.str()));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<STRING>(item));
+  closeCommands(commands);
+  for (auto &unit : batch.units)
+    invokeUnit(unit, context, drawables);
+  DL.splice(batch.units);
   DL_CLEAR;
+
+  context.addDrawables(drawables);
+  context.diffComplete();
+  context.stateNotifyComplete();
 }
+
 /**
-\brief
+\brief opens a recording on the calling thread. Returns false if the
+thread already records, in which case the calls join that recording.
 */
-void uxdevice::platform::image(const std::string &s) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<IMAGE>(s));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<IMAGE>(item));
-  DL_CLEAR;
+bool uxdevice::platform::beginRecording(void) {
+  if (recording.owner)
+    return false;
+
+  recording.owner = this;
+  recording.chunk = std::make_unique<SubmissionChunk>();
+  recording.chunk->units.account(DL);
+  return true;
 }
+
 /**
-\brief
+\brief publishes the recording of the calling thread. The chunk is
+pushed to the queue without locking and the renderer is woken to merge
+it.
 */
-void uxdevice::platform::pen(const Paint &p) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<PEN>(p));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<PEN>(item));
-  DL_CLEAR;
+void uxdevice::platform::endRecording(void) {
+  if (recording.owner != this)
+    return;
+
+  recording.chunk->commands.reset();
+  submissions.push(recording.chunk.release());
+  recording.owner = nullptr;
+  context.stateNotifyComplete();
 }
 
-void uxdevice::platform::pen(u_int32_t c) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<PEN>(c));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<PEN>(item));
-  DL_CLEAR;
+/**
+\internal
+\brief applies the published recordings to the context in sequence and
+moves their units to the display list. The display list lock is held by
+the caller. The drawing objects are collected so that they are added
+to the context at once after the lock is released.
+*/
+void uxdevice::platform::mergeRecordings(DrawingOutputBatch &drawables) {
+  while (auto chunk = submissions.pop()) {
+    closeCommands(commands);
+    for (auto &unit : chunk->units)
+      invokeUnit(unit, context, drawables);
+    DL.splice(chunk->units);
+  }
 }
 
-void uxdevice::platform::pen(const string &c) {
+/**
+\brief writes the display list to a binary snapshot file. Units holding
+functions, such as stroke, fill or the line options, cannot be written.
+A display list that holds one is not written as the snapshot would draw
+differently. Returns false if the list or the file could not be written.
+*/
+bool uxdevice::platform::writeSnapshot(const std::string &sFile) {
+  DisplayListSnapshot snapshot;
+  bool bComplete = true;
+
   DL_SPIN;
-  auto item = DL.emplace_back(make_shared<PEN>(c));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<PEN>(item));
+  for (auto &unit : DL)
+    if (unit && !snapshot.add(unit.get())) {
+      bComplete = false;
+      break;
+    }
   DL_CLEAR;
+
+  if (!bComplete) {
+    context.errorState(
+        __func__, __LINE__, __FILE__,
+        std::string_view("The display list holds units that cannot be "
+                         "written to a snapshot."));
+    return false;
+  }
+
+  bool bRet = snapshot.write(sFile);
+  if (!bRet)
+    context.errorState(__func__, __LINE__, __FILE__,
+                       std::string_view("The snapshot could not be written."));
+  return bRet;
 }
+
+/**
+\brief maps a snapshot file and appends its units to the display list.
+The records are used in place and the units are constructed directly
+through the batch path, so the drawables are partitioned once when the
+batch is committed. If a batch is already open the units join it.
+*/
+bool uxdevice::platform::readSnapshot(const std::string &sFile) {
+  DisplayListSnapshot snapshot;
+  if (!snapshot.map(sFile)) {
+    context.errorState(__func__, __LINE__, __FILE__,
+                       std::string_view("The snapshot could not be read."));
+    return false;
+  }
+
+  bool bOpened = !batching();
+  if (bOpened)
+    beginBatch();
+
+  for (std::size_t i = 0; i < snapshot.size(); i++) {
+    const SNAPSHOT_RECORD &r = snapshot.record(i);
+
+    switch (r.type) {
+    case snapshotUnit::text:
+      submitUnit<STRING>(std::string(snapshot.data(r.data, r.size)));
+      break;
+    case snapshotUnit::area:
+      submitUnit<AREA>(static_cast<areaType>(r.setting), r.d[0], r.d[1],
+                       r.d[2], r.d[3], r.d[4], r.d[5]);
+      break;
+    case snapshotUnit::font:
+      submitUnit<FONT>(std::string(snapshot.data(r.data, r.size)));
+      break;
+    case snapshotUnit::pen:
+      submitUnit<PEN>(snapshot.paint(r.paint));
+      break;
+    case snapshotUnit::background:
+      submitUnit<BACKGROUND>(snapshot.paint(r.paint));
+      break;
+    case snapshotUnit::textOutline:
+      submitUnit<TEXTOUTLINE>(snapshot.paint(r.paint), r.d[0]);
+      break;
+    case snapshotUnit::textFill:
+      submitUnit<TEXTFILL>(snapshot.paint(r.paint));
+      break;
+    case snapshotUnit::textShadow:
+      submitUnit<TEXTSHADOW>(snapshot.paint(r.paint), (int)r.d[0], r.d[1],
+                             r.d[2]);
+      break;
+    case snapshotUnit::align:
+      submitUnit<ALIGN>(static_cast<alignment>(r.setting));
+      break;
+    case snapshotUnit::antialias:
+      submitUnit<ANTIALIAS>(static_cast<antialias>(r.setting));
+      break;
+    case snapshotUnit::image:
+      submitUnit<IMAGE>(std::string(snapshot.data(r.data, r.size)));
+      break;
+    case snapshotUnit::commands: {
+      std::string_view stream = snapshot.data(r.data, r.size);
+      submit<COMMANDBUFFER>(
+          reinterpret_cast<const std::uint8_t *>(stream.data()),
+          stream.size());
+    } break;
+    case snapshotUnit::clear:
+      submit<CLEARUNIT>(static_cast<clearTarget>(r.setting));
+      break;
+    case snapshotUnit::drawText:
+      submitDrawable<DRAWTEXT>();
+      break;
+    case snapshotUnit::drawImage:
+      submitDrawable<DRAWIMAGE>();
+      break;
+    case snapshotUnit::drawArea:
+      submitDrawable<DRAWAREA>();
+      break;
+    }
+  }
+
+  if (bOpened)
+    commit();
+
+  return true;
+}
+
+void uxdevice::platform::antiAlias(antialias antialias) {
+  submitUnit<ANTIALIAS>(antialias);
+}
+
+/**
+\brief sets the text
+*/
+void uxdevice::platform::text(const std::string &s) { submitUnit<STRING>(s); }
+/**
+\brief
+*/
+void uxdevice::platform::text(const std::stringstream &s) {
+  submitUnit<STRING>(s.str());
+}
+/**
+\brief
+*/
+void uxdevice::platform::image(const std::string &s) { submitUnit<IMAGE>(s); }
+/**
+\brief
+*/
+void uxdevice::platform::pen(const Paint &p) { submitUnit<PEN>(p); }
+
+void uxdevice::platform::pen(u_int32_t c) { submitUnit<PEN>(c); }
+
+void uxdevice::platform::pen(const string &c) { submitUnit<PEN>(c); }
 void uxdevice::platform::pen(const std::string &c, double w, double h) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<PEN>(c, w, h));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<PEN>(item));
-  DL_CLEAR;
+  submitUnit<PEN>(c, w, h);
 }
 
 void uxdevice::platform::pen(double _r, double _g, double _b) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<PEN>(_r, _g, _b));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<PEN>(item));
-  DL_CLEAR;
+  submitUnit<PEN>(_r, _g, _b);
 }
 void uxdevice::platform::pen(double _r, double _g, double _b, double _a) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<PEN>(_r, _g, _b, _a));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<PEN>(item));
-  DL_CLEAR;
+  submitUnit<PEN>(_r, _g, _b, _a);
 }
 void uxdevice::platform::pen(double x0, double y0, double x1, double y1,
                              const ColorStops &cs) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<PEN>(x0, y0, x1, y1, cs));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<PEN>(item));
-  DL_CLEAR;
+  submitUnit<PEN>(x0, y0, x1, y1, cs);
 }
 void uxdevice::platform::pen(double cx0, double cy0, double radius0, double cx1,
                              double cy1, double radius1, const ColorStops &cs) {
-  DL_SPIN;
-  auto item = DL.emplace_back(
-      make_shared<PEN>(cx0, cy0, radius0, cx1, cy1, radius1, cs));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<PEN>(item));
-  DL_CLEAR;
+  submitUnit<PEN>(cx0, cy0, radius0, cx1, cy1, radius1, cs);
 }
 void uxdevice::platform::surfaceBrush(Paint &b) { context.surfaceBrush(b); }
 /**
 \brief
 */
 void uxdevice::platform::background(const Paint &p) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<BACKGROUND>(p));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<BACKGROUND>(item));
-  DL_CLEAR;
-}
-void uxdevice::platform::background(u_int32_t c) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<BACKGROUND>(c));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<BACKGROUND>(item));
-  DL_CLEAR;
+  submitUnit<BACKGROUND>(p);
 }
+void uxdevice::platform::background(u_int32_t c) { submitUnit<BACKGROUND>(c); }
 void uxdevice::platform::background(const string &c) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<BACKGROUND>(c));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<BACKGROUND>(item));
-  DL_CLEAR;
+  submitUnit<BACKGROUND>(c);
 }
 void uxdevice::platform::background(const std::string &c, double w, double h) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<BACKGROUND>(c, w, h));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<BACKGROUND>(item));
-  DL_CLEAR;
+  submitUnit<BACKGROUND>(c, w, h);
 }
 
 void uxdevice::platform::background(double _r, double _g, double _b) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<BACKGROUND>(_r, _g, _b));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<BACKGROUND>(item));
-  DL_CLEAR;
+  submitUnit<BACKGROUND>(_r, _g, _b);
 }
 void uxdevice::platform::background(double _r, double _g, double _b,
                                     double _a) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<BACKGROUND>(_r, _g, _b, _a));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<BACKGROUND>(item));
-  DL_CLEAR;
+  submitUnit<BACKGROUND>(_r, _g, _b, _a);
 }
 void uxdevice::platform::background(double x0, double y0, double x1, double y1,
                                     const ColorStops &cs) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<BACKGROUND>(x0, y0, x1, y1, cs));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<BACKGROUND>(item));
-  DL_CLEAR;
+  submitUnit<BACKGROUND>(x0, y0, x1, y1, cs);
 }
 void uxdevice::platform::background(double cx0, double cy0, double radius0,
                                     double cx1, double cy1, double radius1,
                                     const ColorStops &cs) {
-  DL_SPIN;
-  auto item = DL.emplace_back(
-      make_shared<BACKGROUND>(cx0, cy0, radius0, cx1, cy1, radius1, cs));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<BACKGROUND>(item));
-  DL_CLEAR;
+  submitUnit<BACKGROUND>(cx0, cy0, radius0, cx1, cy1, radius1, cs);
 }
 /**
 \brief
 */
 void uxdevice::platform::textAlignment(alignment aln) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<ALIGN>(aln));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<ALIGN>(item));
-  DL_CLEAR;
+  submitUnit<ALIGN>(aln);
 }
 
 /**
 \brief
 */
 void uxdevice::platform::textOutline(const Paint &p, double dWidth) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTOUTLINE>(p, dWidth));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTOUTLINE>(item));
-  DL_CLEAR;
+  submitUnit<TEXTOUTLINE>(p, dWidth);
 }
 void uxdevice::platform::textOutline(u_int32_t c, double dWidth) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTOUTLINE>(c, dWidth));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTOUTLINE>(item));
-  DL_CLEAR;
+  submitUnit<TEXTOUTLINE>(c, dWidth);
 }
 /**
 \brief
 */
 void uxdevice::platform::textOutline(const string &c, double dWidth) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTOUTLINE>(c, dWidth));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTOUTLINE>(item));
-  DL_CLEAR;
+  submitUnit<TEXTOUTLINE>(c, dWidth);
 }
 void uxdevice::platform::textOutline(const std::string &c, double w, double h,
                                      double dWidth) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTOUTLINE>(c, w, h, dWidth));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTOUTLINE>(item));
-  DL_CLEAR;
+  submitUnit<TEXTOUTLINE>(c, w, h, dWidth);
 }
 /**
 \brief
 */
 void uxdevice::platform::textOutline(double _r, double _g, double _b,
                                      double dWidth) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTOUTLINE>(_r, _g, _b, dWidth));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTOUTLINE>(item));
-  DL_CLEAR;
+  submitUnit<TEXTOUTLINE>(_r, _g, _b, dWidth);
 }
 /**
 \brief
 */
 void uxdevice::platform::textOutline(double _r, double _g, double _b, double _a,
                                      double dWidth) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTOUTLINE>(_r, _g, _b, _a, dWidth));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTOUTLINE>(item));
-  DL_CLEAR;
+  submitUnit<TEXTOUTLINE>(_r, _g, _b, _a, dWidth);
 }
 void uxdevice::platform::textOutline(double x0, double y0, double x1, double y1,
                                      const ColorStops &cs, double dWidth) {
-  DL_SPIN;
-  auto item =
-      DL.emplace_back(make_shared<TEXTOUTLINE>(x0, y0, x1, y1, cs, dWidth));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTOUTLINE>(item));
-  DL_CLEAR;
+  submitUnit<TEXTOUTLINE>(x0, y0, x1, y1, cs, dWidth);
 }
 
 void uxdevice::platform::textOutline(double cx0, double cy0, double radius0,
                                      double cx1, double cy1, double radius1,
                                      const ColorStops &cs, double dWidth) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTOUTLINE>(
-      cx0, cy0, radius0, cx1, cy1, radius1, cs, dWidth));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTOUTLINE>(item));
-  DL_CLEAR;
+  submitUnit<TEXTOUTLINE>(cx0, cy0, radius0, cx1, cy1, radius1, cs, dWidth);
 }
 
 /**
 \brief clears the current text outline from the context.
 */
 void uxdevice::platform::textOutlineNone(void) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<CLEARUNIT>(
-      [=]() { context.currentUnits.textoutline.reset(); }));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<CLEARUNIT>(clearTarget::textOutline);
 }
 
-void uxdevice::platform::textFill(const Paint &p) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTFILL>(p));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTFILL>(item));
-  DL_CLEAR;
-}
-void uxdevice::platform::textFill(u_int32_t c) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTFILL>(c));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTFILL>(item));
-  DL_CLEAR;
-}
-void uxdevice::platform::textFill(const string &c) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTFILL>(c));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTFILL>(item));
-  DL_CLEAR;
-}
+void uxdevice::platform::textFill(const Paint &p) { submitUnit<TEXTFILL>(p); }
+void uxdevice::platform::textFill(u_int32_t c) { submitUnit<TEXTFILL>(c); }
+void uxdevice::platform::textFill(const string &c) { submitUnit<TEXTFILL>(c); }
 void uxdevice::platform::textFill(const string &c, double w, double h) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTFILL>(c, w, h));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTFILL>(item));
-  DL_CLEAR;
+  submitUnit<TEXTFILL>(c, w, h);
 }
 void uxdevice::platform::textFill(double _r, double _g, double _b) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTFILL>(_r, _g, _b));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTFILL>(item));
-  DL_CLEAR;
+  submitUnit<TEXTFILL>(_r, _g, _b);
 }
 void uxdevice::platform::textFill(double _r, double _g, double _b, double _a) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTFILL>(_r, _g, _b, _a));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTFILL>(item));
-  DL_CLEAR;
+  submitUnit<TEXTFILL>(_r, _g, _b, _a);
 }
 void uxdevice::platform::textFill(double x0, double y0, double x1, double y1,
                                   const ColorStops &cs) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTFILL>(x0, y0, x1, y1, cs));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTFILL>(item));
-  DL_CLEAR;
+  submitUnit<TEXTFILL>(x0, y0, x1, y1, cs);
 }
 void uxdevice::platform::textFill(double cx0, double cy0, double radius0,
                                   double cx1, double cy1, double radius1,
                                   const ColorStops &cs) {
-  DL_SPIN;
-  auto item = DL.emplace_back(
-      make_shared<TEXTFILL>(cx0, cy0, radius0, cx1, cy1, radius1, cs));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTFILL>(item));
-  DL_CLEAR;
+  submitUnit<TEXTFILL>(cx0, cy0, radius0, cx1, cy1, radius1, cs);
 }
 
 /**
 \brief clears the current text fill from the context.
 */
 void uxdevice::platform::textFillNone(void) {
-  DL_SPIN;
-  auto item = DL.emplace_back(
-      make_shared<CLEARUNIT>([=]() { context.currentUnits.textfill.reset(); }));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<CLEARUNIT>(clearTarget::textFill);
 }
 /**
 \brief
 */
 void uxdevice::platform::textShadow(const Paint &p, int r, double xOffset,
                                     double yOffset) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTSHADOW>(p, r, xOffset, yOffset));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTSHADOW>(item));
-  DL_CLEAR;
+  submitUnit<TEXTSHADOW>(p, r, xOffset, yOffset);
 }
 void uxdevice::platform::textShadow(u_int32_t c, int r, double xOffset,
                                     double yOffset) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTSHADOW>(c, r, xOffset, yOffset));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTSHADOW>(item));
-  DL_CLEAR;
+  submitUnit<TEXTSHADOW>(c, r, xOffset, yOffset);
 }
 /**
 \brief
 */
 void uxdevice::platform::textShadow(const string &c, int r, double xOffset,
                                     double yOffset) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTSHADOW>(c, r, xOffset, yOffset));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTSHADOW>(item));
-  DL_CLEAR;
+  submitUnit<TEXTSHADOW>(c, r, xOffset, yOffset);
 }
 void uxdevice::platform::textShadow(const std::string &c, double w, double h,
                                     int r, double xOffset, double yOffset) {
-  DL_SPIN;
-  auto item =
-      DL.emplace_back(make_shared<TEXTSHADOW>(c, w, h, r, xOffset, yOffset));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTSHADOW>(item));
-  DL_CLEAR;
+  submitUnit<TEXTSHADOW>(c, w, h, r, xOffset, yOffset);
 }
 
 /**
@@ -1157,170 +1311,230 @@ void uxdevice::platform::textShadow(const std::string &c, double w, double h,
 */
 void uxdevice::platform::textShadow(double _r, double _g, double _b, int r,
                                     double xOffset, double yOffset) {
-  DL_SPIN;
-  auto item =
-      DL.emplace_back(make_shared<TEXTSHADOW>(_r, _g, _b, r, xOffset, yOffset));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTSHADOW>(item));
-  DL_CLEAR;
+  submitUnit<TEXTSHADOW>(_r, _g, _b, r, xOffset, yOffset);
 }
 /**
 \brief
 */
 void uxdevice::platform::textShadow(double _r, double _g, double _b, double _a,
                                     int r, double xOffset, double yOffset) {
-  DL_SPIN;
-  auto item = DL.emplace_back(
-      make_shared<TEXTSHADOW>(_r, _g, _b, _a, r, xOffset, yOffset));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTSHADOW>(item));
-  DL_CLEAR;
+  submitUnit<TEXTSHADOW>(_r, _g, _b, _a, r, xOffset, yOffset);
 }
 
 void uxdevice::platform::textShadow(double x0, double y0, double x1, double y1,
                                     const ColorStops &cs, int r, double xOffset,
                                     double yOffset) {
-  DL_SPIN;
-  auto item = DL.emplace_back(
-      make_shared<TEXTSHADOW>(x0, y0, x1, y1, cs, r, xOffset, yOffset));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTSHADOW>(item));
-  DL_CLEAR;
+  submitUnit<TEXTSHADOW>(x0, y0, x1, y1, cs, r, xOffset, yOffset);
 }
 
 void uxdevice::platform::textShadow(double cx0, double cy0, double radius0,
                                     double cx1, double cy1, double radius1,
                                     const ColorStops &cs, int r, double xOffset,
                                     double yOffset) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<TEXTSHADOW>(
-      cx0, cy0, radius0, cx1, cy1, radius1, cs, r, xOffset, yOffset));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<TEXTSHADOW>(item));
-  DL_CLEAR;
+  submitUnit<TEXTSHADOW>(
+       cx0, cy0, radius0, cx1, cy1, radius1, cs, r, xOffset, yOffset);
 }
 
 /**
 \brief clears the current text fill from the context.
 */
 void uxdevice::platform::textShadowNone(void) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<CLEARUNIT>(
-      [=]() { context.currentUnits.textshadow.reset(); }));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<CLEARUNIT>(clearTarget::textShadow);
 }
 
 /**
 \brief
 */
-void uxdevice::platform::font(const std::string &s) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<FONT>(s));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<FONT>(item));
-  DL_CLEAR;
-}
+void uxdevice::platform::font(const std::string &s) { submitUnit<FONT>(s); }
 /**
 \brief
 */
 void uxdevice::platform::area(double x, double y, double w, double h) {
-  DL_SPIN;
-  auto item =
-      DL.emplace_back(make_shared<AREA>(areaType::rectangle, x, y, w, h));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<AREA>(item));
-  DL_CLEAR;
+  submitUnit<AREA>(areaType::rectangle, x, y, w, h);
 }
 
 void uxdevice::platform::area(double x, double y, double w, double h, double rx,
                               double ry) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<AREA>(x, y, w, h, rx, ry));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<AREA>(item));
-  DL_CLEAR;
+  submitUnit<AREA>(x, y, w, h, rx, ry);
 }
 
 void uxdevice::platform::areaCircle(double x, double y, double d) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<AREA>(x, y, d / 2));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<AREA>(item));
-  DL_CLEAR;
+  submitUnit<AREA>(x, y, d / 2);
 }
 
 void uxdevice::platform::areaEllipse(double cx, double cy, double rx,
                                      double ry) {
-  DL_SPIN;
-  auto item =
-      DL.emplace_back(make_shared<AREA>(areaType::ellipse, cx, cy, rx, ry));
-  item->invoke(context);
-  context.setUnit(std::dynamic_pointer_cast<AREA>(item));
+  submitUnit<AREA>(areaType::ellipse, cx, cy, rx, ry);
+}
 
-  DL_CLEAR;
+/**
+\brief
+*/
+uxdevice::drawable uxdevice::platform::drawText(void) {
+  return drawable(submitDrawable<DRAWTEXT>(), &context);
 }
 
 /**
 \brief
 */
-void uxdevice::platform::drawText(void) {
-  DL_SPIN;
-  auto item = DL.emplace_back(make_shared<DRAWTEXT>());
-  item->invoke(context);
-  DL_CLEAR;
-  context.addDrawable(std::dynamic_pointer_cast<DrawingOutput>(item));
+uxdevice::drawable uxdevice::platform::drawImage(void) {
+  return drawable(submitDrawable<DRAWIMAGE>(), &context);
+}
+/**
+\brief
+*/
+uxdevice::drawable uxdevice::platform::drawArea(void) {
+  return drawable(submitDrawable<DRAWAREA>(), &context);
+}
+
+/**
+\internal
+\brief applies a parameter change to the drawing object. The function
+replaces the parameter pointers while the renderer is excluded. It
+returns false when the object does not use the parameter. The drawing
+functions are then rebuilt and the old and new ink areas are damaged.
+Parameters are replaced rather than changed as they may be shared with
+other objects through the display list.
+*/
+void uxdevice::drawable::update(const std::function<bool(void)> &fn) {
+  if (!obj)
+    return;
+
+  cairo_rectangle_int_t previous = obj->inkRectangle;
+
+  obj->functorsLock(true);
+  bool bChanged = fn();
+  obj->functorsLock(false);
+
+  if (!bChanged) {
+    context->errorState(__func__, __LINE__, __FILE__,
+                        std::string_view("The drawing object does not use "
+                                         "the parameter."));
+    return;
+  }
+
+  obj->build(*context);
+  context->update(obj, previous);
+  context->stateNotifyComplete();
 }
 
 /**
 \brief
 */
-void uxdevice::platform::drawImage(void) {
-  DL_SPIN;
+void uxdevice::drawable::text(const std::string &s) {
+  auto unit = std::make_shared<STRING>(s);
+  update([=]() {
+    if (obj->tag != unitType::drawText)
+      return false;
+    std::static_pointer_cast<DRAWTEXT>(obj)->text = unit;
+    return true;
+  });
+}
 
-  auto item = DL.emplace_back(make_shared<DRAWIMAGE>());
-  item->invoke(context);
-  DL_CLEAR;
-  context.addDrawable(std::dynamic_pointer_cast<DrawingOutput>(item));
+/**
+\internal
+\brief sets the area of any of the drawing objects.
+*/
+void uxdevice::drawable::area(std::shared_ptr<AREA> unit) {
+  update([=]() {
+    switch (obj->tag) {
+    case unitType::drawText:
+      std::static_pointer_cast<DRAWTEXT>(obj)->area = unit;
+      break;
+    case unitType::drawArea:
+      std::static_pointer_cast<DRAWAREA>(obj)->area = unit;
+      break;
+    case unitType::drawImage:
+      std::static_pointer_cast<DRAWIMAGE>(obj)->area = unit;
+      break;
+    default:
+      return false;
+    }
+    return true;
+  });
 }
+
+void uxdevice::drawable::area(double x, double y, double w, double h) {
+  area(std::make_shared<AREA>(areaType::rectangle, x, y, w, h));
+}
+
+void uxdevice::drawable::area(double x, double y, double w, double h,
+                              double rx, double ry) {
+  area(std::make_shared<AREA>(x, y, w, h, rx, ry));
+}
+
+void uxdevice::drawable::areaCircle(double x, double y, double d) {
+  area(std::make_shared<AREA>(x, y, d / 2));
+}
+
+void uxdevice::drawable::areaEllipse(double cx, double cy, double rx,
+                                     double ry) {
+  area(std::make_shared<AREA>(areaType::ellipse, cx, cy, rx, ry));
+}
+
 /**
 \brief
 */
-void uxdevice::platform::drawArea(void) {
-  DL_SPIN;
+void uxdevice::drawable::pen(const Paint &p) {
+  auto unit = std::make_shared<PEN>(p);
+  update([=]() {
+    if (!obj->state ||
+        !(obj->tag == unitType::drawText || obj->tag == unitType::drawArea))
+      return false;
+    RenderState s = *obj->state;
+    s.pen = unit;
+    obj->state = context->intern(s);
+    return true;
+  });
+}
 
-  auto item = DL.emplace_back(std::make_shared<DRAWAREA>());
-  item->invoke(context);
-  DL_CLEAR;
-  context.addDrawable(std::dynamic_pointer_cast<DrawingOutput>(item));
+/**
+\brief
+*/
+void uxdevice::drawable::background(const Paint &p) {
+  auto unit = std::make_shared<BACKGROUND>(p);
+  update([=]() {
+    if (!obj->state || obj->tag != unitType::drawArea)
+      return false;
+    RenderState s = *obj->state;
+    s.background = unit;
+    obj->state = context->intern(s);
+    return true;
+  });
 }
 
+/**
+\brief hides or shows the object. The functions are not rebuilt, the
+ink area is repainted so that the object is removed or drawn again.
+*/
+void uxdevice::drawable::visible(bool b) {
+  if (!obj || obj->bVisible == b)
+    return;
+
+  obj->bVisible = b;
+  if (obj->viewportInked && obj->bOnscreen) {
+    context->state(obj);
+    context->stateNotifyComplete();
+  }
+}
+
+bool uxdevice::drawable::visible(void) { return obj && obj->bVisible; }
+
 /**
 \brief
 */
 void uxdevice::platform::save(void) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func = std::bind(cairo_save, _1);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submitCommand(COMMANDBUFFER::opcode::save);
 }
 /**
 \brief
 */
 void uxdevice::platform::restore(void) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func = std::bind(cairo_restore, _1);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submitCommand(COMMANDBUFFER::opcode::restore);
 }
 
 void uxdevice::platform::push(content c) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func;
   if (c == content::all) {
     func = std::bind(cairo_push_group, _1);
@@ -1328,90 +1542,59 @@ void uxdevice::platform::push(content c) {
     func = std::bind(cairo_push_group_with_content, _1,
                      static_cast<cairo_content_t>(c));
   }
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<FUNCTION>(func);
 }
 
 void uxdevice::platform::pop(bool bToSource) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func;
   if (bToSource) {
     func = std::bind(cairo_pop_group_to_source, _1);
   } else {
     func = std::bind(cairo_pop_group, _1);
   }
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<FUNCTION>(func);
 }
 
 /**
 \brief
 */
 void uxdevice::platform::translate(double x, double y) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func = std::bind(cairo_translate, _1, x, y);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submitCommand(COMMANDBUFFER::opcode::translate, x, y);
 }
 /**
 \brief
 */
 void uxdevice::platform::rotate(double angle) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func = std::bind(cairo_rotate, _1, angle);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submitCommand(COMMANDBUFFER::opcode::rotate, angle);
 }
 /**
 \brief
 */
 void uxdevice::platform::scale(double x, double y) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func = std::bind(cairo_scale, _1, x, y);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submitCommand(COMMANDBUFFER::opcode::scale, x, y);
 }
 /**
 \brief
 */
 void uxdevice::platform::transform(const Matrix &m) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func = std::bind(cairo_transform, _1, &m._matrix);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<FUNCTION>(func);
 }
 /**
 \brief
 */
 void uxdevice::platform::matrix(const Matrix &m) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func = std::bind(cairo_set_matrix, _1, &m._matrix);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<FUNCTION>(func);
 }
 /**
 \brief
 */
 void uxdevice::platform::identity(void) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func = std::bind(cairo_identity_matrix, _1);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submitCommand(COMMANDBUFFER::opcode::identity);
 }
 
 /**
@@ -1419,7 +1602,6 @@ void uxdevice::platform::identity(void) {
 */
 void uxdevice::platform::device(double &x, double &y) {
   using namespace std::placeholders;
-  DL_SPIN;
   auto fn = [](cairo_t *cr, double &x, double &y) {
     double _x = x;
     double _y = y;
@@ -1429,16 +1611,13 @@ void uxdevice::platform::device(double &x, double &y) {
   };
 
   CAIRO_FUNCTION func = std::bind(fn, _1, x, y);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<FUNCTION>(func);
 }
 /**
 \brief
 */
 void uxdevice::platform::deviceDistance(double &x, double &y) {
   using namespace std::placeholders;
-  DL_SPIN;
   auto fn = [](cairo_t *cr, double &x, double &y) {
     double _x = x;
     double _y = y;
@@ -1448,16 +1627,13 @@ void uxdevice::platform::deviceDistance(double &x, double &y) {
   };
 
   CAIRO_FUNCTION func = std::bind(fn, _1, x, y);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<FUNCTION>(func);
 }
 /**
 \brief
 */
 void uxdevice::platform::user(double &x, double &y) {
   using namespace std::placeholders;
-  DL_SPIN;
   auto fn = [](cairo_t *cr, double &x, double &y) {
     double _x = x, _y = y;
     cairo_device_to_user(cr, &_x, &_y);
@@ -1466,9 +1642,7 @@ void uxdevice::platform::user(double &x, double &y) {
   };
 
   CAIRO_FUNCTION func = std::bind(fn, _1, x, y);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<FUNCTION>(func);
 }
 
 /**
@@ -1476,7 +1650,6 @@ void uxdevice::platform::user(double &x, double &y) {
 */
 void uxdevice::platform::userDistance(double &x, double &y) {
   using namespace std::placeholders;
-  DL_SPIN;
   auto fn = [](cairo_t *cr, double &x, double &y) {
     double _x = x, _y = y;
     cairo_device_to_user_distance(cr, &_x, &_y);
@@ -1485,9 +1658,7 @@ void uxdevice::platform::userDistance(double &x, double &y) {
   };
 
   CAIRO_FUNCTION func = std::bind(fn, _1, x, y);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<FUNCTION>(func);
 }
 
 /**
@@ -1495,12 +1666,9 @@ void uxdevice::platform::userDistance(double &x, double &y) {
 */
 void uxdevice::platform::cap(lineCap c) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_OPTION func =
       std::bind(cairo_set_line_cap, _1, static_cast<cairo_line_cap_t>(c));
-  auto item = DL.emplace_back(make_shared<OPTION_FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<OPTION_FUNCTION>(func);
 }
 
 /**
@@ -1508,12 +1676,9 @@ void uxdevice::platform::cap(lineCap c) {
 */
 void uxdevice::platform::join(lineJoin j) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func =
       std::bind(cairo_set_line_join, _1, static_cast<cairo_line_join_t>(j));
-  auto item = DL.emplace_back(make_shared<OPTION_FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<OPTION_FUNCTION>(func);
 }
 
 /**
@@ -1521,11 +1686,8 @@ void uxdevice::platform::join(lineJoin j) {
 */
 void uxdevice::platform::lineWidth(double dWidth) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func = std::bind(cairo_set_line_width, _1, dWidth);
-  auto item = DL.emplace_back(make_shared<OPTION_FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<OPTION_FUNCTION>(func);
 }
 
 /**
@@ -1533,11 +1695,8 @@ void uxdevice::platform::lineWidth(double dWidth) {
 */
 void uxdevice::platform::miterLimit(double dLimit) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func = std::bind(cairo_set_miter_limit, _1, dLimit);
-  auto item = DL.emplace_back(make_shared<OPTION_FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<OPTION_FUNCTION>(func);
 }
 
 /**
@@ -1546,12 +1705,9 @@ void uxdevice::platform::miterLimit(double dLimit) {
 void uxdevice::platform::dashes(const std::vector<double> &dashes,
                                 double offset) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func =
       std::bind(cairo_set_dash, _1, dashes.data(), dashes.size(), offset);
-  auto item = DL.emplace_back(make_shared<OPTION_FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<OPTION_FUNCTION>(func);
 }
 
 /**
@@ -1559,11 +1715,8 @@ void uxdevice::platform::dashes(const std::vector<double> &dashes,
 */
 void uxdevice::platform::tollerance(double _t) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func = std::bind(cairo_set_tolerance, _1, _t);
-  auto item = DL.emplace_back(make_shared<OPTION_FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<OPTION_FUNCTION>(func);
 }
 
 /**
@@ -1571,12 +1724,9 @@ void uxdevice::platform::tollerance(double _t) {
 */
 void uxdevice::platform::op(op_t _op) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func =
       std::bind(cairo_set_operator, _1, static_cast<cairo_operator_t>(_op));
-  auto item = DL.emplace_back(make_shared<OPTION_FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<OPTION_FUNCTION>(func);
 }
 
 /**
@@ -1584,12 +1734,9 @@ void uxdevice::platform::op(op_t _op) {
 */
 void uxdevice::platform::source(Paint &p) {
   using namespace std::placeholders;
-  DL_SPIN;
   auto fn = [](cairo_t *cr, Paint &p) { p.emit(cr); };
   CAIRO_FUNCTION func = std::bind(fn, _1, p);
-  auto item = DL.emplace_back(make_shared<OPTION_FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<OPTION_FUNCTION>(func);
 }
 
 /**
@@ -1597,17 +1744,11 @@ void uxdevice::platform::source(Paint &p) {
 */
 void uxdevice::platform::arc(double xc, double yc, double radius, double angle1,
                              double angle2, bool bNegative) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func;
-  if (bNegative) {
-    func = std::bind(cairo_arc_negative, _1, xc, yc, radius, angle1, angle2);
-  } else {
-    func = std::bind(cairo_arc, _1, xc, yc, radius, angle1, angle2);
-  }
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  if (bNegative)
+    submitCommand(COMMANDBUFFER::opcode::arcNegative, xc, yc, radius, angle1,
+                  angle2);
+  else
+    submitCommand(COMMANDBUFFER::opcode::arc, xc, yc, radius, angle1, angle2);
 }
 
 /**
@@ -1615,34 +1756,20 @@ void uxdevice::platform::arc(double xc, double yc, double radius, double angle1,
 */
 void uxdevice::platform::curve(double x1, double y1, double x2, double y2,
                                double x3, double y3, bool bRelative) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func;
-  if (bRelative) {
-    func = std::bind(cairo_rel_curve_to, _1, x1, y1, x2, y2, x3, y3);
-  } else {
-    func = std::bind(cairo_curve_to, _1, x1, y1, x2, y2, x3, y3);
-  }
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  if (bRelative)
+    submitCommand(COMMANDBUFFER::opcode::relCurve, x1, y1, x2, y2, x3, y3);
+  else
+    submitCommand(COMMANDBUFFER::opcode::curve, x1, y1, x2, y2, x3, y3);
 }
 
 /**
 \brief
 */
 void uxdevice::platform::line(double x, double y, bool bRelative) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func;
-  if (bRelative) {
-    func = std::bind(cairo_rel_line_to, _1, x, y);
-  } else {
-    func = std::bind(cairo_line_to, _1, x, y);
-  }
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  if (bRelative)
+    submitCommand(COMMANDBUFFER::opcode::relLine, x, y);
+  else
+    submitCommand(COMMANDBUFFER::opcode::line, x, y);
 }
 
 /**
@@ -1650,33 +1777,23 @@ void uxdevice::platform::line(double x, double y, bool bRelative) {
 */
 void uxdevice::platform::stroke(bool bPreserve) {
   using namespace std::placeholders;
-  DL_SPIN;
   CAIRO_FUNCTION func;
   if (bPreserve) {
     func = std::bind(cairo_stroke_preserve, _1);
   } else {
     func = std::bind(cairo_stroke, _1);
   }
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submit<FUNCTION>(func);
 }
 
 /**
 \brief
 */
 void uxdevice::platform::move(double x, double y, bool bRelative) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func;
-  if (bRelative) {
-    func = std::bind(cairo_rel_move_to, _1, x, y);
-  } else {
-    func = std::bind(cairo_move_to, _1, x, y);
-  }
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  if (bRelative)
+    submitCommand(COMMANDBUFFER::opcode::relMove, x, y);
+  else
+    submitCommand(COMMANDBUFFER::opcode::move, x, y);
 }
 
 /**
@@ -1684,12 +1801,7 @@ void uxdevice::platform::move(double x, double y, bool bRelative) {
 */
 void uxdevice::platform::rectangle(double x, double y, double width,
                                    double height) {
-  using namespace std::placeholders;
-  DL_SPIN;
-  CAIRO_FUNCTION func = std::bind(cairo_rectangle, _1, x, y, width, height);
-  auto item = DL.emplace_back(make_shared<FUNCTION>(func));
-  item->invoke(context);
-  DL_CLEAR;
+  submitCommand(COMMANDBUFFER::opcode::rectangle, x, y, width, height);
 }
 
 /***************************************************************************/
@@ -39,8 +39,14 @@ options when compiling the source.
 #include "uxmatrix.hpp"
 #include "uxpaint.hpp"
 
+#include "uxmemoryaccountant.hpp"
+#include "uxrastercache.hpp"
+#include "uxworkerpool.hpp"
 #include "uxdisplaycontext.hpp"
 #include "uxdisplayunits.hpp"
+#include "uxdisplaylist.hpp"
+#include "uxsnapshot.hpp"
+#include "uxtilerenderer.hpp"
 
 #include "uxcairoimage.hpp"
 
@@ -66,6 +72,49 @@ public:
   double x = 0, y = 0;
 };
 
+// times are in milliseconds. a late frame took longer than the frame
+// period to render, the ticks that passed during it are dropped.
+using frameStats = class frameStats {
+public:
+  std::size_t frames = 0, late = 0, dropped = 0;
+  double lastFrameTime = 0, averageFrameTime = 0;
+  // draws skipped as opaque objects covered them.
+  std::size_t culled = 0, lastFrameCulled = 0;
+};
+
+/**
+\internal
+\class drawable
+\brief The handle returned by the draw functions. It keeps the drawing
+object alive and changes its parameters in place. Only the previous and
+the new ink areas of the object are repainted, other objects keep their
+cached rendering.
+*/
+class drawable {
+public:
+  drawable() {}
+  drawable(std::shared_ptr<DrawingOutput> _obj, DisplayContext *_context)
+      : obj(_obj), context(_context) {}
+  bool valid(void) { return obj != nullptr; }
+
+  void text(const std::string &s);
+  void area(double x, double y, double w, double h);
+  void area(double x, double y, double w, double h, double rx, double ry);
+  void areaCircle(double x, double y, double d);
+  void areaEllipse(double cx, double cy, double rx, double ry);
+  void pen(const Paint &p);
+  void background(const Paint &p);
+  void visible(bool b);
+  bool visible(void);
+
+private:
+  void update(const std::function<bool(void)> &fn);
+  void area(std::shared_ptr<AREA> _area);
+
+  std::shared_ptr<DrawingOutput> obj = nullptr;
+  DisplayContext *context = nullptr;
+};
+
 /**
 \internal
 \class platform
@@ -84,12 +133,79 @@ public:
   void closeWindow(void);
   void backgroundBrush(Paint &p) { context.brush = p; }
   bool processing(void) { return bProcessing; }
+  // bytes of display list memory returned after compaction and clear.
+  std::size_t reclaimedBytes(void) { return DL.reclaimed(); }
+
+  // when set, clear keeps the objects of the frame so that the next
+  // frame is drawn only where it differs.
+  void diffFrames(bool b) { context.bDiffFrames = b; }
+
+  // limits the rectangles clipping the damage of a frame. zero clips
+  // with the damaged region as is.
+  void damageRectangles(std::size_t n) { context.maxDamageRectangles = n; }
+
+  // damage is rendered once per frame at this rate. zero renders as
+  // soon as damage arrives.
+  void frameRate(int fps) { framesPerSecond = std::max(fps, 0); }
+  int frameRate(void) { return framesPerSecond; }
+  frameStats stats(void);
+  void resetStats(void);
+
+  // renders the damage of each frame as tiles on worker threads.
+  void tiledRendering(bool b) { context.tileRenderer = b ? &tiles : nullptr; }
+
+  // presents frames through a shared memory segment when the server
+  // supports it. sharedMemory() reports whether the path is in use.
+  void sharedMemoryPresent(bool b) { context.sharedMemory(b); }
+  bool sharedMemory(void) { return context.sharedMemory(); }
+
+  // bytes the cached renderings of drawing objects may hold.
+  void rasterCacheBudget(std::size_t bytes) {
+    context.rasterCache.budget(bytes);
+  }
+  std::size_t rasterCacheBytes(void) { return context.rasterCache.bytes(); }
+
+  // where the cached renderings are held, client images or server
+  // pixmaps. automatic measures both once the window is open.
+  void rasterCacheBacking(cacheBacking b) { context.cacheSurfaceBacking(b); }
+  cacheBacking rasterCacheBacking(void) {
+    return context.cacheSurfaceBacking();
+  }
+
+  // one budget for all of the caches, rendered buffers, text shadows and
+  // images. zero is unlimited. the least recently used are released.
+  void setMemoryBudget(std::size_t bytes) { context.memory.budget(bytes); }
+  std::size_t memoryBudget(void) { return context.memory.budget(); }
+  std::size_t memoryBytes(void) { return context.memory.bytes(); }
+
+  // releases cached memory, as when the system is short of it. the
+  // released caches are built again when drawn.
+  void trimMemory(trimLevel level) {
+    context.memory.trim(level);
+    context.stateNotifyComplete();
+  }
+
+  // positions the window over the document. objects are drawn in
+  // document coordinates, the window shows the area beginning at x, y.
+  void scroll(int x, int y);
+  void scrollBy(int dx, int dy);
+  int scrollX(void) { return context.viewport().x; }
+  int scrollY(void) { return context.viewport().y; }
 
   void startProcessing(void);
 
   void clear(void);
   void notifyComplete(void);
 
+  void beginBatch(void);
+  void commit(void);
+
+  bool beginRecording(void);
+  void endRecording(void);
+
+  bool writeSnapshot(const std::string &sFile);
+  bool readSnapshot(const std::string &sFile);
+
   void text(const std::string &s);
   void text(const std::stringstream &s);
   void image(const std::string &s);
@@ -184,9 +300,9 @@ public:
   void areaLines(std::vector<double> lines);
   // void areaPath(std::vector<PathStep> path);
 
-  void drawText(void);
-  void drawImage(void);
-  void drawArea(void);
+  drawable drawText(void);
+  drawable drawImage(void);
+  drawable drawArea(void);
   void antiAlias(antialias antialias);
 
   void save(void);
@@ -241,6 +357,8 @@ public:
 
 private:
   void renderLoop(void);
+  void paceFrame(void);
+  void frameComplete(void);
   void exposeRegions(void);
   void dispatchEvent(const event &e);
   void drawCaret(const int x, const int y, const int h);
@@ -260,20 +378,138 @@ private:
 
 private:
   DisplayContext context = DisplayContext();
+  TileRenderer tiles = {};
   std::atomic<bool> bProcessing = false;
-  int framesPerSecond = 60;
+  std::atomic<int> framesPerSecond = 60;
+
+  // frame clock, used by the render thread only.
+  std::chrono::steady_clock::time_point frameStart = {};
+  std::chrono::steady_clock::time_point nextFrame = {};
+
+  std::atomic<std::size_t> frameCount = 0;
+  std::atomic<std::size_t> lateFrames = 0;
+  std::atomic<std::size_t> droppedFrames = 0;
+  std::atomic<std::int64_t> frameTimeTotal = 0;
+  std::atomic<std::int64_t> frameTimeLast = 0;
+  std::atomic<std::size_t> culledTotal = 0;
+  std::atomic<std::size_t> culledLast = 0;
   errorHandler fnError = nullptr;
   eventHandler fnEvents = nullptr;
 
-  typedef std::list<std::shared_ptr<DisplayUnit>> DisplayUnitStorage;
-  DisplayUnitStorage DL = {};
-  DisplayUnitStorage::iterator itDL_Processed = DL.begin();
+  DisplayList DL = {};
+  std::size_t compactSlice = 256;
 
-  std::atomic_flag DL_readwrite = ATOMIC_FLAG_INIT;
+  // kept on a line of its own so the flag does not share it with
+  // fields written by the producers.
+  alignas(64) std::atomic_flag DL_readwrite = ATOMIC_FLAG_INIT;
 
 #define DL_SPIN while (DL_readwrite.test_and_set(std::memory_order_acquire))
+#define DL_TRY !DL_readwrite.test_and_set(std::memory_order_acquire)
 #define DL_CLEAR DL_readwrite.clear(std::memory_order_release)
 
+  // recordings. a thread with an open recording constructs its units
+  // within its own chunk, nothing is shared until the chunk is published
+  // to the queue. the renderer merges published chunks in order.
+  typedef struct _RECORDING {
+    platform *owner = nullptr;
+    std::unique_ptr<SubmissionChunk> chunk = nullptr;
+  } RECORDING;
+  static thread_local RECORDING recording;
+  alignas(64) SubmissionQueue submissions = {};
+  SubmissionChunk *recordingChunk(void) {
+    return recording.owner == this ? recording.chunk.get() : nullptr;
+  }
+  void mergeRecordings(DrawingOutputBatch &drawables);
+
+  // batch submission. a batch belongs to the thread that opened it, its
+  // units are collected into the thread's own list without locking and
+  // are not applied to the context until commit. commit applies them in
+  // order and publishes them to the display list under one lock.
+  typedef struct _BATCH {
+    platform *owner = nullptr;
+    DisplayList units = {};
+    std::shared_ptr<COMMANDBUFFER> commands = nullptr;
+  } BATCH;
+  static thread_local BATCH batch;
+  bool batching(void) { return batch.owner == this; }
+
+  // path and transform operations are appended to the trailing command
+  // buffer of the list. the buffer is replayed when another unit follows
+  // or the list is published.
+  std::shared_ptr<COMMANDBUFFER> commands = nullptr;
+  void closeCommands(std::shared_ptr<COMMANDBUFFER> &buffer) {
+    if (buffer) {
+      buffer->invoke(context);
+      buffer.reset();
+    }
+  }
+
+  template <typename... Args>
+  void submitCommand(COMMANDBUFFER::opcode op, Args... args) {
+    if (SubmissionChunk *chunk = recordingChunk()) {
+      if (!chunk->commands)
+        chunk->commands = chunk->units.emplace_back<COMMANDBUFFER>();
+      chunk->commands->append(op, args...);
+    } else if (batching()) {
+      if (!batch.commands)
+        batch.commands = batch.units.emplace_back<COMMANDBUFFER>();
+      batch.commands->append(op, args...);
+    } else {
+      DL_SPIN;
+      if (!commands)
+        commands = DL.emplace_back<COMMANDBUFFER>();
+      commands->append(op, args...);
+      DL_CLEAR;
+    }
+  }
+
+  template <typename T, typename... Args>
+  std::shared_ptr<T> submit(Args &&... args) {
+    std::shared_ptr<T> item;
+    if (SubmissionChunk *chunk = recordingChunk()) {
+      chunk->commands.reset();
+      item = chunk->units.emplace_back<T>(std::forward<Args>(args)...);
+    } else if (batching()) {
+      batch.commands.reset();
+      item = batch.units.emplace_back<T>(std::forward<Args>(args)...);
+    } else {
+      DL_SPIN;
+      closeCommands(commands);
+      item = DL.emplace_back<T>(std::forward<Args>(args)...);
+      item->invoke(context);
+      DL_CLEAR;
+    }
+    return item;
+  }
+
+  template <typename T, typename... Args>
+  std::shared_ptr<T> submitUnit(Args &&... args) {
+    std::shared_ptr<T> item;
+    if (SubmissionChunk *chunk = recordingChunk()) {
+      chunk->commands.reset();
+      item = chunk->units.emplace_back<T>(std::forward<Args>(args)...);
+    } else if (batching()) {
+      batch.commands.reset();
+      item = batch.units.emplace_back<T>(std::forward<Args>(args)...);
+    } else {
+      DL_SPIN;
+      closeCommands(commands);
+      item = DL.emplace_back<T>(std::forward<Args>(args)...);
+      item->invoke(context);
+      context.setUnit(item);
+      DL_CLEAR;
+    }
+    return item;
+  }
+
+  template <typename T> std::shared_ptr<T> submitDrawable(void) {
+    std::shared_ptr<T> item = submit<T>();
+    if (recordingChunk() || batching())
+      return item;
+    context.addDrawable(item);
+    return item;
+  }
+
   std::vector<eventHandler> onfocus = {};
   std::vector<eventHandler> onblur = {};
   std::vector<eventHandler> onresize = {};
@@ -293,4 +529,30 @@ private:
   std::vector<eventHandler> &getEventVector(eventType evtType);
 }; // namespace uxdevice
 
+/**
+\class recorder
+\brief scoped recording for a producer thread. While the recorder is in
+scope, api calls made on the thread are recorded without taking the
+display list lock. When it goes out of scope the recording is published
+and later merged by the renderer in the order the recordings were
+published.
+Drawables returned during a recording are built when it is merged.
+*/
+class recorder {
+public:
+  recorder(platform &_owner) : owner(_owner) {
+    bOpened = owner.beginRecording();
+  }
+  ~recorder() {
+    if (bOpened)
+      owner.endRecording();
+  }
+  recorder(const recorder &other) = delete;
+  recorder &operator=(const recorder &other) = delete;
+
+private:
+  platform &owner;
+  bool bOpened = false;
+};
+
 } // namespace uxdevice
@@ -40,9 +40,12 @@ bool uxdevice::DisplayContext::surfacePrime() {
   // wait for render work if none has already been provided.
   // the state routines which produce region rectangular information
   // supplies the notification.
+  // the state is tested again under the mutex, a notification given
+  // after the first test is not lost.
   if (!bRet) {
     std::unique_lock<std::mutex> lk(mutexRenderWork);
-    cvRenderWork.wait(lk);
+    if (!state())
+      cvRenderWork.wait(lk);
     lk.unlock();
   }
 
@@ -102,12 +105,13 @@ void uxdevice::DisplayContext::flush() {
 In addition, other work may be applied such as paint, hwoever those go
 into a separate list as the operating system provides these message
 independently, that is Configure window event and a separate paint
-rectangle.
+rectangle. Only the latest size is kept, the configure events of a drag
+arriving within one frame produce one resize.
 */
 void uxdevice::DisplayContext::resizeSurface(const int w, const int h) {
   SURFACE_REQUESTS_SPIN;
-  if (w != windowWidth || h != windowHeight)
-    _surfaceRequests.emplace_back(w, h);
+  _surfaceRequests.clear();
+  _surfaceRequests.emplace_back(w, h);
   SURFACE_REQUESTS_CLEAR;
 }
 /**
@@ -124,108 +128,461 @@ void uxdevice::DisplayContext::applySurfaceRequests(void) {
     auto flat = _surfaceRequests.back();
     _surfaceRequests.clear();
 
+    if (flat.w == windowWidth && flat.h == windowHeight &&
+        !bReallocateBuffer.exchange(false)) {
+      SURFACE_REQUESTS_CLEAR;
+      return;
+    }
+
     XCB_SPIN;
     cairo_surface_flush(xcbSurface);
     cairo_xcb_surface_set_size(xcbSurface, flat.w, flat.h);
     ERROR_CHECK(xcbSurface);
     XCB_CLEAR;
 
+    REGIONS_SPIN;
+    cairo_rectangle_int_t previous = {offsetx, offsety, windowWidth,
+                                      windowHeight};
     windowWidth = flat.w;
     windowHeight = flat.h;
+    cairo_rectangle_int_t current = {offsetx, offsety, windowWidth,
+                                     windowHeight};
+    REGIONS_CLEAR;
+
+    allocateBackBuffer(flat.w, flat.h);
+    moveViewport(previous, current);
   }
   SURFACE_REQUESTS_CLEAR;
 }
 
 void uxdevice::DisplayContext::render(void) {
   bClearFrame = false;
-
-  // rectangle of area needs painting background first.
-  // these are subareas perhaps multiples exist because of resize
-  // coordinates. The information is generated from the
-  // paint dispatch event. When the window is opened
-  // render work will contain entire window
+  memory.beginFrame();
 
   applySurfaceRequests();
 
-  //partitionVisibility();
-
+  // all of the pending damage is drained into one region. overlapping
+  // requests, such as two objects sharing an area, are painted once.
+  // damage is in document coordinates and is limited to the viewport.
+  // os requests are in window coordinates and are served from the
+  // back buffer without drawing.
+  cairo_region_t *damage = cairo_region_create();
+  cairo_region_t *exposed = cairo_region_create();
   REGIONS_SPIN;
-  cairo_region_t *current = nullptr;
-  while (!_regions.empty()) {
-    CairoRegion r = _regions.front();
-    _regions.pop_front();
-    REGIONS_CLEAR;
-    // os surface requests are ideally full screen block coordinates
-    // when multiples exist, such as clear, set surface as well as
-    // objects that fit within the larger bounds,
-    // simply continue as there is no redraw needed
-    if (current) {
-      cairo_region_overlap_t ovrlp =
-          cairo_region_contains_rectangle(current, &r.rect);
-      if (ovrlp == CAIRO_REGION_OVERLAP_IN)
-        continue;
+  for (auto &r : _regions)
+    cairo_region_union_rectangle(r.bOSsurface ? exposed : damage, &r.rect);
+  _regions.clear();
+  cairo_rectangle_int_t view = {offsetx, offsety, windowWidth, windowHeight};
+  REGIONS_CLEAR;
+  scrollSurface(view, damage, exposed);
+  cairo_region_intersect_rectangle(damage, &view);
+
+  if (!cairo_region_is_empty(damage)) {
+    std::vector<cairo_rectangle_int_t> clip =
+        simplify(damage, maxDamageRectangles);
+    CairoRegion r(damage);
+
+    if (TileRenderer *tiles = tileRenderer) {
+      tiles->render(*this, r._ptr, view.x, view.y);
+
     } else {
-      if (r.bOSsurface)
-        current = cairo_region_reference(r._ptr);
+      // the xcb spin locks the primary cairo context
+      // while drawing operations occur. the damage is the clip
+      // for the background and every object of the frame. the
+      // context is translated so that objects draw in document
+      // coordinates.
+      XCB_SPIN;
+      cairo_save(cr);
+      cairo_translate(cr, -view.x, -view.y);
+      for (auto &rect : clip)
+        cairo_rectangle(cr, rect.x, rect.y, rect.width, rect.height);
+      cairo_clip(cr);
+      BRUSH_SPIN;
+      brush.emit(cr);
+      BRUSH_CLEAR;
+      cairo_paint(cr);
+      ERROR_CHECK(cr);
+      XCB_CLEAR;
+
+      plot(r);
+
+      XCB_SPIN;
+      cairo_restore(cr);
+      ERROR_CHECK(cr);
+      XCB_CLEAR;
     }
 
-    // the xcb spin locks the primary cairo context
-    // while drawing operations occur. these blocks
-    // are distinct work items
-    XCB_SPIN;
-    cairo_push_group(cr);
-    BRUSH_SPIN;
-    brush.emit(cr);
-    BRUSH_CLEAR;
-    ERROR_CHECK(cr);
-    XCB_CLEAR;
+    for (auto &rect : clip) {
+      cairo_rectangle_int_t shown = {rect.x - view.x, rect.y - view.y,
+                                     rect.width, rect.height};
+      cairo_region_union_rectangle(exposed, &shown);
+    }
+  }
+  cairo_region_destroy(damage);
 
-    XCB_SPIN;
-    cairo_rectangle(cr, r.rect.x, r.rect.y, r.rect.width, r.rect.height);
-    cairo_fill(cr);
-    ERROR_CHECK(cr);
+  presentFrame(exposed);
+  cairo_region_destroy(exposed);
+
+  flush();
+  rasterCache.evaluate(*this);
+  releaseCaches();
+  memory.enforce(*this);
+}
+
+/**
+\internal
+\brief The routine copies the region of the back buffer to the window.
+The region is in window coordinates. A back buffer in shared memory is
+put by the server directly, otherwise it is sent through the protocol
+by cairo.
+*/
+void uxdevice::DisplayContext::presentFrame(cairo_region_t *region) {
+  cairo_rectangle_int_t bounds = {0, 0, windowWidth, windowHeight};
+  cairo_region_intersect_rectangle(region, &bounds);
+  if (cairo_region_is_empty(region))
+    return;
+
+  std::vector<cairo_rectangle_int_t> clip =
+      simplify(region, maxDamageRectangles);
+
+  // the server reads the segment when it processes the requests. the
+  // round trip ensures this has happened before the next frame draws
+  // into the buffer.
+  XCB_SPIN;
+  if (shm.addr) {
+    cairo_surface_flush(backBuffer);
+    for (auto &rect : clip)
+      xcb_shm_put_image(connection, window, graphics, shm.width, shm.height,
+                        rect.x, rect.y, rect.width, rect.height, rect.x,
+                        rect.y, screen->root_depth, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                        0, shm.seg, 0);
+    cairo_surface_mark_dirty(xcbSurface);
     XCB_CLEAR;
+    free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection),
+                                   nullptr));
+    return;
+  }
+
+  cairo_surface_flush(backBuffer);
+  cairo_save(windowCr);
+  for (auto &rect : clip)
+    cairo_rectangle(windowCr, rect.x, rect.y, rect.width, rect.height);
+  cairo_clip(windowCr);
+  cairo_set_operator(windowCr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface(windowCr, backBuffer, 0, 0);
+  cairo_paint(windowCr);
+  cairo_restore(windowCr);
+  ERROR_CHECK(windowCr);
+  XCB_CLEAR;
+}
 
+/**
+\internal
+\brief The routine allocates the back buffer at the size of the window
+and points the cairo context at it. Objects are drawn into the back
+buffer, the window is updated from it. The pixels of the previous buffer
+are kept anchored at the top left, as the window's bit gravity does, so
+only the area the previous buffer did not cover is damaged. Growing a
+window repaints the L shaped strip along the right and bottom edges.
+*/
+void uxdevice::DisplayContext::allocateBackBuffer(int w, int h) {
+  w = std::max(w, 1);
+  h = std::max(h, 1);
+
+  SHMSEGMENT segment = {};
+  cairo_surface_t *surface = nullptr;
+  if (bSharedMemory)
+    surface = allocateSharedBuffer(w, h, segment);
+  if (!surface)
+    surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, w, h);
+  ERROR_CHECK(surface);
+  cairo_t *surfaceCr = cairo_create(surface);
+  ERROR_CHECK(surfaceCr);
+
+  cairo_rectangle_int_t kept = {0, 0, 0, 0};
+
+  XCB_SPIN;
+  if (backBuffer) {
+    kept.width = std::min(w, cairo_image_surface_get_width(backBuffer));
+    kept.height = std::min(h, cairo_image_surface_get_height(backBuffer));
+    cairo_set_operator(surfaceCr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(surfaceCr, backBuffer, 0, 0);
+    cairo_rectangle(surfaceCr, 0, 0, kept.width, kept.height);
+    cairo_fill(surfaceCr);
+    cairo_set_operator(surfaceCr, CAIRO_OPERATOR_OVER);
+  }
+  std::swap(backBuffer, surface);
+  std::swap(cr, surfaceCr);
+  std::swap(shm, segment);
+  XCB_CLEAR;
+
+  if (surfaceCr)
+    cairo_destroy(surfaceCr);
+  if (surface)
+    cairo_surface_destroy(surface);
+  releaseSharedBuffer(segment);
+
+  // the new area, in document coordinates.
+  cairo_rectangle_int_t whole = {0, 0, w, h};
+  cairo_region_t *exposed = cairo_region_create_rectangle(&whole);
+  cairo_region_subtract_rectangle(exposed, &kept);
+
+  REGIONS_SPIN;
+  for (int i = 0; i < cairo_region_num_rectangles(exposed); i++) {
+    cairo_rectangle_int_t rect;
+    cairo_region_get_rectangle(exposed, i, &rect);
+    _regions.emplace_back(CairoRegion{false, offsetx + rect.x,
+                                      offsety + rect.y, rect.width,
+                                      rect.height});
+  }
+  REGIONS_CLEAR;
+  cairo_region_destroy(exposed);
+}
+
+/**
+\internal
+\brief releases the back buffer and its context.
+*/
+void uxdevice::DisplayContext::releaseBackBuffer(void) {
+  XCB_SPIN;
+  if (cr)
+    cairo_destroy(cr);
+  cr = nullptr;
+  if (backBuffer)
+    cairo_surface_destroy(backBuffer);
+  backBuffer = nullptr;
+  XCB_CLEAR;
+
+  releaseSharedBuffer(shm);
+}
 
-    plot(r);
+/**
+\internal
+\brief The routine selects the shared memory present path. The back
+buffer is allocated again at the next frame.
+*/
+void uxdevice::DisplayContext::sharedMemory(bool b) {
+  bSharedMemory = b;
+  bReallocateBuffer = true;
+  SURFACE_REQUESTS_SPIN;
+  if (_surfaceRequests.empty())
+    _surfaceRequests.emplace_back(windowWidth, windowHeight);
+  SURFACE_REQUESTS_CLEAR;
+}
 
+/**
+\internal
+\brief returns true when the back buffer is presented through shared
+memory.
+*/
+bool uxdevice::DisplayContext::sharedMemory(void) {
+  XCB_SPIN;
+  bool ret = shm.addr != nullptr;
+  XCB_CLEAR;
+  return ret;
+}
+
+/**
+\internal
+\brief The routine creates an image surface over a shared memory segment
+attached to the server. Returns nullptr when the server lacks the
+extension, when the segment cannot be attached as with a remote display,
+or when the window depth does not match the image format. The segment
+is marked for removal once attached so that it is freed when detached.
+*/
+cairo_surface_t *
+uxdevice::DisplayContext::allocateSharedBuffer(int w, int h,
+                                               SHMSEGMENT &segment) {
+  if (!connection || !screen || screen->root_depth != 24)
+    return nullptr;
+
+  // a request of an extension the server lacks closes the connection.
+  const xcb_query_extension_reply_t *extension =
+      xcb_get_extension_data(connection, &xcb_shm_id);
+  if (!extension || !extension->present)
+    return nullptr;
+
+  xcb_shm_query_version_reply_t *version = xcb_shm_query_version_reply(
+      connection, xcb_shm_query_version(connection), nullptr);
+  if (!version)
+    return nullptr;
+  free(version);
+
+  int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, w);
+  int id = shmget(IPC_PRIVATE, (std::size_t)stride * h, IPC_CREAT | 0600);
+  if (id < 0)
+    return nullptr;
+
+  void *addr = shmat(id, nullptr, 0);
+  if (addr == (void *)-1) {
+    shmctl(id, IPC_RMID, nullptr);
+    return nullptr;
+  }
+
+  xcb_shm_seg_t seg = xcb_generate_id(connection);
+  xcb_generic_error_t *error = xcb_request_check(
+      connection, xcb_shm_attach_checked(connection, seg, id, 0));
+  shmctl(id, IPC_RMID, nullptr);
+  if (error) {
+    free(error);
+    shmdt(addr);
+    return nullptr;
+  }
 
+  segment = {seg, addr, w, h};
+  return cairo_image_surface_create_for_data(
+      static_cast<unsigned char *>(addr), CAIRO_FORMAT_RGB24, w, h, stride);
+}
+
+/**
+\internal
+\brief detaches the segment from the server and the process.
+*/
+void uxdevice::DisplayContext::releaseSharedBuffer(SHMSEGMENT &segment) {
+  if (!segment.addr)
+    return;
+  xcb_shm_detach(connection, segment.seg);
+  shmdt(segment.addr);
+  segment = {};
+}
+
+/**
+\internal
+\brief The routine moves the pixels of the back buffer when the viewport
+has changed since the last frame. The part that remains visible is moved
+within the buffer and added to the window region presented, the strips
+exposed by the move are added to the damage. The window is updated from
+the buffer rather than copied from itself, as parts of the window that
+were obscured hold no valid pixels.
+*/
+void uxdevice::DisplayContext::scrollSurface(const cairo_rectangle_int_t &view,
+                                             cairo_region_t *damage,
+                                             cairo_region_t *present) {
+  int dx = surfacex - view.x;
+  int dy = surfacey - view.y;
+  if (!dx && !dy)
+    return;
+  surfacex = view.x;
+  surfacey = view.y;
+
+  cairo_region_t *exposed = cairo_region_create_rectangle(&view);
+  int w = view.width - std::abs(dx);
+  int h = view.height - std::abs(dy);
+  if (w > 0 && h > 0) {
+    int sx = std::max(-dx, 0), sy = std::max(-dy, 0);
+    int tx = std::max(dx, 0), ty = std::max(dy, 0);
+
+    // rows are moved in the order that does not overwrite rows yet to
+    // be moved.
     XCB_SPIN;
-    cairo_pop_group_to_source(cr);
-    cairo_paint(cr);
-    ERROR_CHECK(cr);
+    cairo_surface_flush(backBuffer);
+    unsigned char *data = cairo_image_surface_get_data(backBuffer);
+    int stride = cairo_image_surface_get_stride(backBuffer);
+    for (int i = 0; i < h; i++) {
+      int row = ty > sy ? h - 1 - i : i;
+      std::memmove(data + (ty + row) * stride + tx * 4,
+                   data + (sy + row) * stride + sx * 4, w * 4);
+    }
+    cairo_surface_mark_dirty(backBuffer);
     XCB_CLEAR;
 
-    flush();
+    cairo_rectangle_int_t moved = {tx, ty, w, h};
+    cairo_region_union_rectangle(present, &moved);
 
-    // processing surface requests
-    applySurfaceRequests();
-    REGIONS_SPIN;
-    if (bClearFrame) {
-      bClearFrame = false;
-      break;
-    }
+    cairo_rectangle_int_t kept = {view.x + tx, view.y + ty, w, h};
+    cairo_region_subtract_rectangle(exposed, &kept);
   }
-  REGIONS_CLEAR;
-  cairo_region_destroy(current);
+  cairo_region_union(damage, exposed);
+  cairo_region_destroy(exposed);
+}
+
+/**
+\internal
+\brief The routine returns at most limit rectangles covering the region,
+these form the clip of the frame. The pair of rectangles whose bounding
+box adds the least area is merged until the limit is met. A region with
+many more rectangles than the limit is reduced to its extents. The
+region is grown to the returned rectangles. A limit of zero keeps the
+rectangles of the region.
+*/
+std::vector<cairo_rectangle_int_t>
+uxdevice::DisplayContext::simplify(cairo_region_t *region,
+                                   std::size_t limit) {
+  std::size_t count = cairo_region_num_rectangles(region);
+
+  if (limit && count > limit * 4) {
+    cairo_rectangle_int_t extents;
+    cairo_region_get_extents(region, &extents);
+    cairo_region_union_rectangle(region, &extents);
+    return {extents};
+  }
+
+  std::vector<cairo_rectangle_int_t> rects(count);
+  for (std::size_t i = 0; i < count; i++)
+    cairo_region_get_rectangle(region, i, &rects[i]);
+
+  if (!limit || count <= limit)
+    return rects;
+
+  auto bounds = [](const cairo_rectangle_int_t &a,
+                   const cairo_rectangle_int_t &b) {
+    int x = std::min(a.x, b.x);
+    int y = std::min(a.y, b.y);
+    return cairo_rectangle_int_t{
+        x, y, std::max(a.x + a.width, b.x + b.width) - x,
+        std::max(a.y + a.height, b.y + b.height) - y};
+  };
+  auto area = [](const cairo_rectangle_int_t &a) {
+    return (long)a.width * (long)a.height;
+  };
+
+  while (rects.size() > limit) {
+    std::size_t bestA = 0, bestB = 1;
+    long bestCost = LONG_MAX;
+    for (std::size_t a = 0; a < rects.size(); a++)
+      for (std::size_t b = a + 1; b < rects.size(); b++) {
+        long cost = area(bounds(rects[a], rects[b])) - area(rects[a]) -
+                    area(rects[b]);
+        if (cost < bestCost) {
+          bestCost = cost;
+          bestA = a;
+          bestB = b;
+        }
+      }
+    rects[bestA] = bounds(rects[bestA], rects[bestB]);
+    rects.erase(rects.begin() + bestB);
+  }
+
+  for (auto &rect : rects)
+    cairo_region_union_rectangle(region, &rect);
+  return rects;
 }
 /**
 \internal
-\brief The allocates an xcb and cairo image surface.
+\brief The routine allocates a buffer for the rendering of a drawing
+object. The surface is a pixmap of the server or a client image as the
+backing in use selects. An image is created when the pixmap cannot be.
 */
 uxdevice::DRAWBUFFER uxdevice::DisplayContext::allocateBuffer(int width,
                                                               int height) {
-#if 0
-  XCB_SPIN;
-  cairo_surface_t *rendered =
-  cairo_surface_create_similar (xcbSurface,
-                                CAIRO_CONTENT_COLOR_ALPHA,
-                                width, height);
-  XCB_CLEAR;
-#endif // 0
+  cairo_surface_t *rendered = nullptr;
 
-  cairo_surface_t *rendered =
-      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+#if defined(__linux__)
+  if (bufferBacking == cacheBacking::server) {
+    XCB_SPIN;
+    if (xcbSurface)
+      rendered = cairo_surface_create_similar(
+          xcbSurface, CAIRO_CONTENT_COLOR_ALPHA, width, height);
+    XCB_CLEAR;
+    if (rendered && cairo_surface_status(rendered)) {
+      cairo_surface_destroy(rendered);
+      rendered = nullptr;
+    }
+  }
+#endif
+
+  if (!rendered)
+    rendered = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
   ERROR_CHECK(rendered);
 
   cairo_t *cr = cairo_create(rendered);
@@ -233,6 +590,97 @@ uxdevice::DRAWBUFFER uxdevice::DisplayContext::allocateBuffer(int width,
 
   return DRAWBUFFER{cr, rendered};
 }
+/**
+\internal
+\brief sets the backing of the buffers rendered from now on. Buffers
+already rendered keep theirs until they are released.
+*/
+void uxdevice::DisplayContext::cacheSurfaceBacking(cacheBacking b) {
+  requestedBacking = b;
+  if (windowOpen)
+    selectBacking();
+}
+
+/**
+\internal
+\brief resolves the requested backing. Called once the window and back
+buffer exist and when another backing is requested.
+*/
+void uxdevice::DisplayContext::selectBacking(void) {
+  cacheBacking b = requestedBacking;
+  if (b == cacheBacking::automatic)
+    b = measureBacking();
+  bufferBacking = b;
+}
+
+/**
+\internal
+\brief The routine measures which backing draws cached objects faster.
+A buffer of each backing is composited repeatedly into an image of the
+back buffer's format, as the renderers draw cached objects. Pixmaps are
+composited into the client side back buffer by reading them back, the
+cost depends on the server and the transport so it is measured rather
+than assumed. Returns image when no pixmap can be created.
+*/
+uxdevice::cacheBacking uxdevice::DisplayContext::measureBacking(void) {
+  static constexpr int bufferSize = 128;
+  static constexpr int iterations = 16;
+
+#if defined(__linux__)
+  cairo_surface_t *server = nullptr;
+  XCB_SPIN;
+  if (xcbSurface)
+    server = cairo_surface_create_similar(
+        xcbSurface, CAIRO_CONTENT_COLOR_ALPHA, bufferSize, bufferSize);
+  XCB_CLEAR;
+  if (!server)
+    return cacheBacking::image;
+  if (cairo_surface_status(server)) {
+    cairo_surface_destroy(server);
+    return cacheBacking::image;
+  }
+
+  cairo_surface_t *image = cairo_image_surface_create(
+      CAIRO_FORMAT_ARGB32, bufferSize, bufferSize);
+  cairo_surface_t *target = cairo_image_surface_create(
+      CAIRO_FORMAT_RGB24, bufferSize * 2, bufferSize * 2);
+  cairo_t *targetCr = cairo_create(target);
+
+  // renders a translucent disc into the buffer, then times its
+  // compositing at each quarter of the target.
+  auto measure = [&](cairo_surface_t *buffer) {
+    cairo_t *bufferCr = cairo_create(buffer);
+    cairo_set_source_rgba(bufferCr, 0.2, 0.4, 0.6, 0.8);
+    cairo_arc(bufferCr, bufferSize / 2, bufferSize / 2, bufferSize / 2, 0,
+              2 * PI);
+    cairo_fill(bufferCr);
+    cairo_destroy(bufferCr);
+    cairo_surface_flush(buffer);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      cairo_set_source_surface(targetCr, buffer, (i & 1) * bufferSize,
+                               ((i >> 1) & 1) * bufferSize);
+      cairo_paint(targetCr);
+    }
+    cairo_surface_flush(target);
+    return std::chrono::steady_clock::now() - start;
+  };
+
+  auto imageTime = measure(image);
+  auto serverTime = measure(server);
+
+  cairo_destroy(targetCr);
+  cairo_surface_destroy(target);
+  cairo_surface_destroy(image);
+  cairo_surface_destroy(server);
+
+  return serverTime < imageTime ? cacheBacking::server : cacheBacking::image;
+#else
+  return cacheBacking::image;
+#endif
+}
+
 /**
 \internal
 \brief The routine frees the buffer.
@@ -246,85 +694,250 @@ void uxdevice::DisplayContext::destroyBuffer(DRAWBUFFER &_buffer) {
 }
 /**
 \internal
-\brief The routine adds a drawing output object to the
-appropriate list, on or offscreen. If the item is on screen,
-a region area paint is requested for the object's area.
+\brief The routine adds a drawing output object to the list and the
+index. If the item is on screen, a region area paint is requested for
+the object's area.
 
 */
 void uxdevice::DisplayContext::addDrawable(
     std::shared_ptr<DrawingOutput> _obj) {
-    viewportRectangle = {(double)offsetx, (double)offsety,
-                       (double)offsetx + (double)windowWidth,
-                       (double)offsety + (double)windowHeight};
+  _obj->viewportInked = true;
+  DRAWABLES_SPIN;
+  drawables.emplace_back(_obj);
+  DRAWABLES_CLEAR;
+
+  viewportRectangle = {(double)offsetx, (double)offsety, (double)windowWidth,
+                       (double)windowHeight};
   _obj->intersect(viewportRectangle);
-  if (_obj->overlap == CAIRO_REGION_OVERLAP_OUT) {
-    DRAWABLES_OFF_SPIN;
-    viewportOff.emplace_back(_obj);
-    DRAWABLES_OFF_CLEAR;
-  } else {
-    DRAWABLES_ON_SPIN;
-    viewportOn.emplace_back(_obj);
-    DRAWABLES_ON_CLEAR;
+
+  VIEWPORT_INDEX_SPIN;
+  viewportIndex.insert(_obj);
+  onscreen(_obj, _obj->overlap != CAIRO_REGION_OVERLAP_OUT);
+  VIEWPORT_INDEX_CLEAR;
+
+  if (_obj->bOnscreen && !reuse(_obj))
     state(_obj);
-  }
-  _obj->viewportInked = true;
+  prepare(_obj);
 }
 /**
 \internal
-\brief The routine scans the offscreen list to see if any are now visible.
+\brief The routine adds a batch of drawing output objects. The list and
+the index are each locked once. The regions of the visible objects are
+queued under a single lock as well.
 */
-void uxdevice::DisplayContext::partitionVisibility(void) {
-  // determine if any off screen elements are visible
-  DRAWABLES_OFF_SPIN;
+void uxdevice::DisplayContext::addDrawables(DrawingOutputBatch &_objs) {
+  if (_objs.empty())
+    return;
+
+  viewportRectangle = {(double)offsetx, (double)offsety, (double)windowWidth,
+                       (double)windowHeight};
+
+  DrawingOutputCollection added = {};
+  for (auto &_obj : _objs) {
+    _obj->intersect(viewportRectangle);
+    _obj->viewportInked = true;
+    added.emplace_back(_obj);
+  }
 
-  viewportRectangle = {(double)offsetx, (double)offsety,
-                       (double)offsetx + (double)windowWidth,
-                       (double)offsety + (double)windowHeight};
-  if(viewportOff.empty()) {
-    DRAWABLES_OFF_CLEAR;
+  VIEWPORT_INDEX_SPIN;
+  for (auto &_obj : _objs) {
+    viewportIndex.insert(_obj);
+    onscreen(_obj, _obj->overlap != CAIRO_REGION_OVERLAP_OUT);
+  }
+  VIEWPORT_INDEX_CLEAR;
+
+  std::list<CairoRegion> damaged = {};
+  for (auto &_obj : _objs) {
+    if (!_obj->bOnscreen || reuse(_obj))
+      continue;
+    std::size_t onum = reinterpret_cast<std::size_t>(_obj.get());
+    damaged.emplace_back(
+        CairoRegion(onum, _obj->inkRectangle.x, _obj->inkRectangle.y,
+                    _obj->inkRectangle.width, _obj->inkRectangle.height));
+  }
+
+  DRAWABLES_SPIN;
+  drawables.splice(drawables.end(), added);
+  DRAWABLES_CLEAR;
+
+  for (auto &_obj : _objs)
+    prepare(_obj);
+
+  REGIONS_SPIN;
+  _regions.splice(_regions.end(), damaged);
+  REGIONS_CLEAR;
+}
+
+/**
+\internal
+\brief The routine is called after the parameters of a drawing object
+have changed in place. Damage is queued for the previous and the new ink
+areas only, when they are on screen. The object is moved within the
+index and its on screen state follows its new area. Objects that have
+not been added, or were removed by clear, only have their functions
+rebuilt.
+*/
+void uxdevice::DisplayContext::update(std::shared_ptr<DrawingOutput> _obj,
+                                      const cairo_rectangle_int_t &previous) {
+  if (!_obj->viewportInked)
     return;
+
+  if (_obj->bOnscreen)
+    state(previous.x, previous.y, previous.width, previous.height);
+
+  viewportRectangle = {(double)offsetx, (double)offsety, (double)windowWidth,
+                       (double)windowHeight};
+  _obj->intersect(viewportRectangle);
+
+  VIEWPORT_INDEX_SPIN;
+  viewportIndex.update(_obj);
+  onscreen(_obj, _obj->overlap != CAIRO_REGION_OVERLAP_OUT);
+  VIEWPORT_INDEX_CLEAR;
+
+  if (_obj->bOnscreen)
+    state(_obj);
+  prepare(_obj);
+}
+
+/**
+\internal
+\brief The routine positions the window over the document. The objects
+within the new viewport are found by a query of the index, only the
+objects of the previous and the new viewport are visited. The next frame
+moves the pixels already in the back buffer and paints the exposed
+strips.
+The position is kept within the positive quadrant.
+*/
+void uxdevice::DisplayContext::offsetPosition(const int x, const int y) {
+  REGIONS_SPIN;
+  cairo_rectangle_int_t previous = {offsetx, offsety, windowWidth,
+                                    windowHeight};
+  offsetx = std::max(x, 0);
+  offsety = std::max(y, 0);
+  cairo_rectangle_int_t current = {offsetx, offsety, windowWidth,
+                                   windowHeight};
+  REGIONS_CLEAR;
+
+  if (previous.x != current.x || previous.y != current.y)
+    moveViewport(previous, current);
+}
+
+/**
+\internal
+\brief returns the area of the document shown by the window.
+*/
+cairo_rectangle_int_t uxdevice::DisplayContext::viewport(void) {
+  REGIONS_SPIN;
+  cairo_rectangle_int_t ret = {offsetx, offsety, windowWidth, windowHeight};
+  REGIONS_CLEAR;
+  return ret;
+}
+
+/**
+\internal
+\brief The routine updates the on screen state of the objects as the
+viewport changes from previous to current. Objects of the previous
+viewport that are not within the current one leave the screen, the
+objects of the current viewport are on screen.
+*/
+void uxdevice::DisplayContext::moveViewport(
+    const cairo_rectangle_int_t &previous,
+    const cairo_rectangle_int_t &current) {
+  DrawingOutputBatch leaving = {};
+  DrawingOutputBatch entering = {};
+
+  VIEWPORT_INDEX_SPIN;
+  viewportIndex.query(previous, leaving);
+  viewportIndex.query(current, entering);
+
+  for (auto &n : leaving) {
+    const cairo_rectangle_int_t &ink = n->indexRectangle;
+    if (ink.x >= current.x + current.width ||
+        current.x >= ink.x + ink.width || ink.y >= current.y + current.height ||
+        current.y >= ink.y + ink.height)
+      onscreen(n, false);
   }
+  for (auto &n : entering)
+    onscreen(n, true);
+  VIEWPORT_INDEX_CLEAR;
+}
 
-  DrawingOutputCollection::iterator obj = viewportOff.begin();
-  while (obj != viewportOff.end()) {
-    std::shared_ptr<DrawingOutput> n = *obj;
-    DRAWABLES_OFF_CLEAR;
+/**
+\internal
+\brief sets the on screen state of the object. The index lock is held
+by the caller. An object leaving the screen with a rendered buffer is
+queued so that the buffer is released if it does not return.
+*/
+void uxdevice::DisplayContext::onscreen(
+    const std::shared_ptr<DrawingOutput> &_obj, bool b) {
+  bool bLeaving = _obj->bOnscreen && !b;
+  _obj->bOnscreen = b;
+  if (!bLeaving || !_obj->bRenderBufferCached || !_obj->_buf.rendered)
+    return;
 
-    n->intersect(viewportRectangle);
-    if (bClearFrame) {
-      bClearFrame=false;
-      break;
-    }
+  RELEASES_SPIN;
+  _releases.emplace_back(RELEASE{_obj, std::chrono::steady_clock::now()});
+  RELEASES_CLEAR;
+}
 
-    if (n->overlap != CAIRO_REGION_OVERLAP_OUT) {
-      DrawingOutputCollection::iterator next = obj;
-      next++;
-      DRAWABLES_ON_SPIN;
-      viewportOn.emplace_back(n);
-      DRAWABLES_ON_CLEAR;
-
-      DRAWABLES_OFF_SPIN;
-      if (bClearFrame || viewportOff.empty()) {
-        bClearFrame=false;
-        DRAWABLES_OFF_CLEAR;
-        break;
-      }
+/**
+\internal
+\brief The routine queues the work an object needs before it is first
+drawn to the worker pool. Text with a shadow has the shadow blurred, the
+draw that finds it missing creates it itself. The shadow is counted by
+the memory accountant. Called once the object has been built.
+*/
+void uxdevice::DisplayContext::prepare(
+    const std::shared_ptr<DrawingOutput> &_obj) {
+  if (_obj->tag != unitType::drawText)
+    return;
 
-      viewportOff.erase(obj);
-      DRAWABLES_OFF_CLEAR;
-      obj = next;
-    } else {
-      obj++;
-    }
+  DRAWTEXT *p = static_cast<DRAWTEXT *>(_obj.get());
+  if (!p->state || !p->state->textshadow || p->shadowImage)
+    return;
 
-    if (bClearFrame) {
-      bClearFrame=false;
-      break;
-    }
+  memory.track({_obj, [=]() { return p->shadowBytes(); },
+                [=]() { return p->lastUse; }, [=]() { p->releaseShadow(); }});
+
+  workerPool.submit(_obj->bOnscreen ? WorkerPool::jobPriority::visible
+                                    : WorkerPool::jobPriority::offscreen,
+                    _obj, [=]() {
+                      p->functorsLock(true);
+                      RenderStatePtr s = p->state;
+                      if (s && s->textshadow && s->font && p->area &&
+                          p->text && p->layout)
+                        p->createShadow();
+                      p->functorsLock(false);
+                    });
+}
 
-    DRAWABLES_OFF_SPIN;
+/**
+\internal
+\brief The routine releases the rendered buffers of the objects that
+have been off screen for the release delay. Objects that have returned
+keep their buffers. Called by the render thread after a frame.
+*/
+void uxdevice::DisplayContext::releaseCaches(void) {
+  auto now = std::chrono::steady_clock::now();
+  DrawingOutputBatch expired = {};
+
+  RELEASES_SPIN;
+  for (auto it = _releases.begin(); it != _releases.end();) {
+    std::chrono::duration<double, std::milli> diff = now - it->when;
+    if (it->obj->bOnscreen) {
+      it = _releases.erase(it);
+    } else if (diff.count() >= releaseDelay) {
+      expired.emplace_back(it->obj);
+      it = _releases.erase(it);
+    } else {
+      it++;
+    }
   }
-  DRAWABLES_OFF_CLEAR;
+  RELEASES_CLEAR;
+
+  for (auto &n : expired)
+    if (!n->bOnscreen)
+      n->releaseCache(*this);
 }
 /**
 \internal
@@ -334,24 +947,183 @@ void uxdevice::DisplayContext::clear(void) {
   bClearFrame = true;
 
   REGIONS_SPIN;
-  _regions.remove_if([](auto &n) { return !n.bOSsurface; });
+  // in diff mode the queued damage still applies to the surface.
+  if (!bDiffFrames)
+    _regions.remove_if([](auto &n) { return !n.bOSsurface; });
 
   offsetx = 0;
   offsety = 0;
   currentUnits = {};
+  _currentState.reset();
 
   REGIONS_CLEAR;
 
-  DRAWABLES_ON_SPIN;
-  viewportOn.clear();
-  DRAWABLES_ON_CLEAR;
-
-  DRAWABLES_OFF_SPIN;
-  viewportOff.clear();
-  DRAWABLES_OFF_CLEAR;
+  STATES_SPIN;
+  _states.clear();
+  _statesPrune = 64;
+  STATES_CLEAR;
+
+  // handles may outlive the lists, mark the objects as removed so
+  // later changes through them do not produce damage.
+  DrawingOutputCollection previous = {};
+
+  DRAWABLES_SPIN;
+  for (auto &n : drawables)
+    n->viewportInked = false;
+  previous.splice(previous.end(), drawables);
+  DRAWABLES_CLEAR;
+
+  VIEWPORT_INDEX_SPIN;
+  viewportIndex.clear();
+  VIEWPORT_INDEX_CLEAR;
+
+  RELEASES_SPIN;
+  _releases.clear();
+  RELEASES_CLEAR;
+
+  rasterCache.clear();
+
+  // the objects are kept to be matched against the next frame. damage
+  // is produced for the ones that are not matched by diffComplete.
+  if (bDiffFrames) {
+    PREVIOUS_FRAME_SPIN;
+    for (auto &n : previous)
+      _previousFrame.emplace(n->contentHash, n);
+    PREVIOUS_FRAME_CLEAR;
+    return;
+  }
 
   state(0, 0, windowWidth, windowHeight);
 }
+
+/**
+\internal
+\brief The routine looks for an object of the previous frame with the
+same content and ink rectangle. When found, the new object takes over its
+rendering resources. Returns true if the matched object is already on
+the surface so that no damage is needed.
+*/
+bool uxdevice::DisplayContext::reuse(std::shared_ptr<DrawingOutput> _obj) {
+  if (!bDiffFrames || !_obj->contentHash || !_obj->hasInkExtents)
+    return false;
+
+  std::shared_ptr<DrawingOutput> old = nullptr;
+
+  PREVIOUS_FRAME_SPIN;
+  auto range = _previousFrame.equal_range(_obj->contentHash);
+  for (auto it = range.first; it != range.second; it++) {
+    const cairo_rectangle_int_t &a = it->second->inkRectangle;
+    const cairo_rectangle_int_t &b = _obj->inkRectangle;
+    if (a.x == b.x && a.y == b.y && a.width == b.width &&
+        a.height == b.height && it->second->bVisible == _obj->bVisible) {
+      old = it->second;
+      _previousFrame.erase(it);
+      break;
+    }
+  }
+  PREVIOUS_FRAME_CLEAR;
+
+  if (!old)
+    return false;
+
+  _obj->adopt(*old);
+  rasterCache.track(_obj);
+  return old->bOnscreen;
+}
+
+/**
+\internal
+\brief The routine ends the matching of a frame. Objects of the previous
+frame that were not matched have been removed or changed, damage is
+queued for the ones that were on the surface.
+*/
+void uxdevice::DisplayContext::diffComplete(void) {
+  std::unordered_multimap<std::size_t, std::shared_ptr<DrawingOutput>>
+      removed = {};
+
+  PREVIOUS_FRAME_SPIN;
+  removed.swap(_previousFrame);
+  PREVIOUS_FRAME_CLEAR;
+
+  for (auto &n : removed)
+    if (n.second->bOnscreen)
+      state(n.second);
+}
+/**
+\internal
+\brief The routine returns the shared block holding the same style units
+as the one given. The units are compared by identity. Blocks are held
+weakly, entries whose blocks have been released are pruned as the table
+grows.
+*/
+uxdevice::RenderStatePtr
+uxdevice::DisplayContext::intern(const RenderState &s) {
+  RenderStateKey key = {s.pen.get(),        s.textoutline.get(),
+                        s.textfill.get(),   s.textshadow.get(),
+                        s.font.get(),       s.align.get(),
+                        s.background.get()};
+  for (auto &o : s.options)
+    key.emplace_back(o.get());
+
+  STATES_SPIN;
+  auto &entry = _states[key];
+  RenderStatePtr ret = entry.lock();
+  if (!ret) {
+    auto block = std::make_shared<RenderState>(s);
+    block->contentHash = block->hash();
+    ret = block;
+    entry = ret;
+
+    // paints of images are counted by the memory accountant.
+    trackPaint(block->pen);
+    trackPaint(block->textoutline);
+    trackPaint(block->textfill);
+    trackPaint(block->textshadow);
+    trackPaint(block->background);
+
+    if (_states.size() >= _statesPrune) {
+      for (auto it = _states.begin(); it != _states.end();) {
+        if (it->second.expired())
+          it = _states.erase(it);
+        else
+          it++;
+      }
+      _statesPrune = std::max(std::size_t(64), _states.size() * 2);
+    }
+  }
+  STATES_CLEAR;
+
+  return ret;
+}
+
+/**
+\internal
+\brief The routine hashes the content of the style units. Units are
+compared by value here, unlike interning, so that blocks built from new
+units with the same settings in the next frame hash equally.
+*/
+std::size_t uxdevice::RenderState::hash(void) const {
+  std::size_t value = 0;
+  hashCombine(value, pen ? pen->hash() : 0);
+  hashCombine(value, textfill ? textfill->hash() : 0);
+  hashCombine(value, background ? background->hash() : 0);
+  if (textoutline) {
+    hashCombine(value, textoutline->hash());
+    hashCombine(value, textoutline->lineWidth);
+  }
+  if (textshadow) {
+    hashCombine(value, textshadow->hash());
+    hashCombine(value, textshadow->radius);
+    hashCombine(value, textshadow->x);
+    hashCombine(value, textshadow->y);
+  }
+  if (font)
+    hashCombine(value, font->description);
+  if (align)
+    hashCombine(value, align->setting);
+  return value;
+}
+
 /**
 \internal
 \brief The routine sets the background surface brush.
@@ -360,7 +1132,8 @@ void uxdevice::DisplayContext::surfaceBrush(Paint &b) {
   BRUSH_SPIN;
   brush = b;
   BRUSH_CLEAR;
-  state(0, 0, windowWidth, windowHeight);
+  cairo_rectangle_int_t r = viewport();
+  state(r.x, r.y, r.width, r.height);
 }
 /**
 \internal
@@ -393,7 +1166,8 @@ void uxdevice::DisplayContext::state(int x, int y, int w, int h) {
 \internal
 \brief The routine adds a surface oriented painting request to the render queue.
 the items are inserted first before any other so that painting
-of a newly resized window area occurs first.
+of a newly resized window area occurs first. The area is given in window
+coordinates and is copied from the back buffer, nothing is drawn.
 */
 void uxdevice::DisplayContext::stateSurface(int x, int y, int w, int h) {
   REGIONS_SPIN;
@@ -415,6 +1189,9 @@ to add work without rendering occurring. However, message
 queue calls this when a resize occurs.
 */
 void uxdevice::DisplayContext::stateNotifyComplete(void) {
+  // taking the mutex orders the notification after a waiter's test of
+  // the state.
+  { std::lock_guard<std::mutex> lk(mutexRenderWork); }
   cvRenderWork.notify_one();
 }
 /**
@@ -424,9 +1201,17 @@ void uxdevice::DisplayContext::stateNotifyComplete(void) {
 bool uxdevice::DisplayContext::state(void) {
 
   REGIONS_SPIN;
-  bool ret = !_regions.empty();
+  bool ret = !_regions.empty() || offsetx != surfacex || offsety != surfacey;
   REGIONS_CLEAR;
 
+  // a trim is served by the render thread.
+  if (!ret)
+    ret = memory.trimPending();
+
+  // published recordings are merged by the render loop.
+  if (!ret && submissions)
+    ret = !submissions->empty();
+
   // surface requests should be performed,
   // the render function sets the surface size
   // and exits if no region work.
@@ -445,23 +1230,19 @@ bool uxdevice::DisplayContext::state(void) {
 
 */
 void uxdevice::DisplayContext::plot(CairoRegion &plotArea) {
-  // if an object is named as what should be updated.
-  // setting the flag informs that the contents
-  // has been evaluated and ma be removed
-  DRAWABLES_ON_SPIN;
-  if (viewportOn.empty()) {
-    DRAWABLES_ON_CLEAR;
-    return;
-  }
-
-  auto itUnit = viewportOn.begin();
-  bool bDone = false;
-  while (!bDone) {
-
-    std::shared_ptr<DrawingOutput> n =*itUnit;
-    DRAWABLES_ON_CLEAR;
-    n->intersect(plotArea._rect);
-
+  // only the objects listed under the cells of the damage are
+  // candidates, they are returned in drawing order.
+  DrawingOutputBatch candidates = {};
+  queryDrawables(plotArea.rect, candidates);
+  culledDraws += cull(candidates, plotArea._ptr);
+
+  for (auto &n : candidates) {
+    if (n->bVisible)
+      n->intersect(plotArea);
+    else
+      n->overlap = CAIRO_REGION_OVERLAP_OUT;
+
+    auto start = std::chrono::steady_clock::now();
     switch (n->overlap) {
     case CAIRO_REGION_OVERLAP_OUT:
       break;
@@ -482,17 +1263,240 @@ void uxdevice::DisplayContext::plot(CairoRegion &plotArea) {
       ERROR_CHECK(cr);
     } break;
     }
+    if (n->overlap != CAIRO_REGION_OVERLAP_OUT)
+      rasterCache.drawn(n, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count());
     if (bClearFrame)
-      bDone = true;
+      break;
+  }
+}
+
+/**
+\internal
+\brief The routine removes the objects whose ink within the damage is
+covered by opaque objects drawn after them. The objects are visited from
+last to first while the covered area grows. The ink is tested against
+the covered area as a rectangle, regions are built only when the ink is
+partly covered. Returns the number of objects removed.
+*/
+std::size_t uxdevice::DisplayContext::cull(DrawingOutputBatch &objects,
+                                           cairo_region_t *damage) {
+  if (std::none_of(objects.begin(), objects.end(),
+                   [](const auto &n) { return n->bOpaque; }))
+    return 0;
+
+  auto clip = [](const cairo_rectangle_int_t &a,
+                 const cairo_rectangle_int_t &b) {
+    int x0 = std::max(a.x, b.x);
+    int y0 = std::max(a.y, b.y);
+    int x1 = std::min(a.x + a.width, b.x + b.width);
+    int y1 = std::min(a.y + a.height, b.y + b.height);
+    return cairo_rectangle_int_t{x0, y0, std::max(x1 - x0, 0),
+                                 std::max(y1 - y0, 0)};
+  };
+
+  cairo_rectangle_int_t bounds;
+  cairo_region_get_extents(damage, &bounds);
+
+  cairo_region_t *covered = cairo_region_create();
+  bool bCovered = false;
+  DrawingOutputBatch kept = {};
+  kept.reserve(objects.size());
+
+  for (auto it = objects.rbegin(); it != objects.rend(); it++) {
+    const std::shared_ptr<DrawingOutput> &n = *it;
+    if (!n->bVisible) {
+      kept.emplace_back(n);
+      continue;
+    }
 
-    DRAWABLES_ON_SPIN;
-    if (!bDone) {
-      itUnit++;
-      bDone = itUnit == viewportOn.end();
+    if (bCovered) {
+      cairo_rectangle_int_t ink = clip(n->inkRectangle, bounds);
+      bool bHidden = true;
+      if (ink.width && ink.height) {
+        switch (cairo_region_contains_rectangle(covered, &ink)) {
+        case CAIRO_REGION_OVERLAP_IN:
+          break;
+        case CAIRO_REGION_OVERLAP_OUT:
+          bHidden = false;
+          break;
+        case CAIRO_REGION_OVERLAP_PART: {
+          cairo_region_t *visible = cairo_region_create_rectangle(&ink);
+          cairo_region_intersect(visible, damage);
+          cairo_region_subtract(visible, covered);
+          bHidden = cairo_region_is_empty(visible);
+          cairo_region_destroy(visible);
+        } break;
+        }
+      }
+      if (bHidden)
+        continue;
     }
+
+    if (n->bOpaque) {
+      cairo_region_union_rectangle(covered, &n->opaqueRectangle);
+      bCovered = !cairo_region_is_empty(covered);
+    }
+    kept.emplace_back(n);
+  }
+  cairo_region_destroy(covered);
+
+  std::size_t culled = objects.size() - kept.size();
+  std::reverse(kept.begin(), kept.end());
+  objects.swap(kept);
+  return culled;
+}
+
+/**
+\internal
+\brief The routine lists the object under the cells of its ink area. The
+drawing order is taken from the order of insertion.
+*/
+void uxdevice::DrawableIndex::insert(
+    const std::shared_ptr<DrawingOutput> &obj) {
+  remove(obj.get());
+  obj->indexOrder = nextOrder++;
+  link(obj);
+}
+
+/**
+\internal
+\brief The routine moves the object to the cells of its current ink
+area. The drawing order is kept, an object not inserted before is
+inserted.
+*/
+void uxdevice::DrawableIndex::update(
+    const std::shared_ptr<DrawingOutput> &obj) {
+  if (!obj->indexOrder) {
+    insert(obj);
+    return;
   }
-  DRAWABLES_ON_CLEAR;
+  remove(obj.get());
+  link(obj);
 }
+
+/**
+\internal
+\brief empties the index.
+*/
+void uxdevice::DrawableIndex::clear(void) {
+  for (auto &c : cells)
+    for (auto &n : c.second)
+      n->bIndexed = false;
+  for (auto &n : large)
+    n->bIndexed = false;
+  cells.clear();
+  large.clear();
+}
+
+/**
+\internal
+\brief appends the objects whose ink touches r to the result in drawing
+order. An object listed in several cells is returned once, the stamp of
+the query marks the objects already taken.
+*/
+void uxdevice::DrawableIndex::query(const cairo_rectangle_int_t &r,
+                                    DrawingOutputBatch &result) {
+  if (r.width <= 0 || r.height <= 0)
+    return;
+
+  queryStamp++;
+  std::size_t first = result.size();
+
+  auto take = [&](const std::shared_ptr<DrawingOutput> &n) {
+    const cairo_rectangle_int_t &ink = n->indexRectangle;
+    if (n->indexStamp == queryStamp || ink.x >= r.x + r.width ||
+        r.x >= ink.x + ink.width || ink.y >= r.y + r.height ||
+        r.y >= ink.y + ink.height)
+      return;
+    n->indexStamp = queryStamp;
+    result.emplace_back(n);
+  };
+
+  for (auto &n : large)
+    take(n);
+
+  int c0 = cell(r.x), c1 = cell(r.x + r.width - 1);
+  int r0 = cell(r.y), r1 = cell(r.y + r.height - 1);
+  for (int row = r0; row <= r1; row++)
+    for (int col = c0; col <= c1; col++) {
+      auto it = cells.find(cellKey(col, row));
+      if (it != cells.end())
+        for (auto &n : it->second)
+          take(n);
+    }
+
+  std::sort(result.begin() + first, result.end(),
+            [](const auto &a, const auto &b) {
+              return a->indexOrder < b->indexOrder;
+            });
+}
+
+/**
+\internal
+\brief lists the object under the cells of its ink area, or within the
+large list when the area covers many cells. Objects without ink are not
+listed.
+*/
+void uxdevice::DrawableIndex::link(const std::shared_ptr<DrawingOutput> &obj) {
+  const cairo_rectangle_int_t &r = obj->inkRectangle;
+  if (!obj->hasInkExtents || r.width <= 0 || r.height <= 0)
+    return;
+
+  obj->indexRectangle = r;
+  obj->bIndexed = true;
+
+  int c0 = cell(r.x), c1 = cell(r.x + r.width - 1);
+  int r0 = cell(r.y), r1 = cell(r.y + r.height - 1);
+  if ((std::size_t)(c1 - c0 + 1) * (r1 - r0 + 1) > largeCells) {
+    large.emplace_back(obj);
+    return;
+  }
+
+  for (int row = r0; row <= r1; row++)
+    for (int col = c0; col <= c1; col++)
+      cells[cellKey(col, row)].emplace_back(obj);
+}
+
+/**
+\internal
+\brief removes the object from the cells it is listed under. The order
+within a cell does not matter, the entry is replaced by the last one.
+*/
+void uxdevice::DrawableIndex::remove(DrawingOutput *obj) {
+  if (!obj->bIndexed)
+    return;
+  obj->bIndexed = false;
+
+  auto erase = [obj](DrawingOutputBatch &v) {
+    auto it = std::find_if(v.begin(), v.end(),
+                           [obj](const auto &n) { return n.get() == obj; });
+    if (it != v.end()) {
+      *it = std::move(v.back());
+      v.pop_back();
+    }
+  };
+
+  const cairo_rectangle_int_t &r = obj->indexRectangle;
+  int c0 = cell(r.x), c1 = cell(r.x + r.width - 1);
+  int r0 = cell(r.y), r1 = cell(r.y + r.height - 1);
+  if ((std::size_t)(c1 - c0 + 1) * (r1 - r0 + 1) > largeCells) {
+    erase(large);
+    return;
+  }
+
+  for (int row = r0; row <= r1; row++)
+    for (int col = c0; col <= c1; col++) {
+      auto it = cells.find(cellKey(col, row));
+      if (it == cells.end())
+        continue;
+      erase(it->second);
+      if (it->second.empty())
+        cells.erase(it);
+    }
+}
+
 /**
 \internal
 \brief The routine stores error conditions.
@@ -34,6 +34,7 @@ class FUNCTION;
 class OPTION_FUNCTION;
 class DisplayUnit;
 class DrawingOutput;
+class TileRenderer;
 
 typedef std::list<std::shared_ptr<DisplayUnit>> DisplayUnitCollection;
 typedef std::list<std::shared_ptr<DisplayUnit>>::iterator
@@ -41,16 +42,24 @@ typedef std::list<std::shared_ptr<DisplayUnit>>::iterator
 typedef std::list<std::shared_ptr<DrawingOutput>> DrawingOutputCollection;
 typedef std::list<std::shared_ptr<DrawingOutput>>::iterator
     DrawingOutputCollectionIter;
+typedef std::vector<std::shared_ptr<DrawingOutput>> DrawingOutputBatch;
 
 class DisplayContext;
 typedef std::function<void(DisplayContext &context)> DrawLogic;
 
-typedef std::list<OPTION_FUNCTION *> CairoOptionFn;
+class SubmissionQueue;
+
+typedef std::list<std::shared_ptr<OPTION_FUNCTION>> CairoOptionFn;
 typedef struct _DRAWBUFFER {
   cairo_t *cr = nullptr;
   cairo_surface_t *rendered = nullptr;
 } DRAWBUFFER;
 
+// where the rendered buffers of drawing objects are held. image buffers
+// are in client memory, server buffers are pixmaps of the display
+// server. automatic selects the faster of the two by measurement.
+enum class cacheBacking : std::uint8_t { automatic, image, server };
+
 class CurrentUnits {
 public:
   std::shared_ptr<AREA> area = nullptr;
@@ -68,6 +77,73 @@ public:
   CairoOptionFn options = {};
 };
 
+/**
+\internal
+\class RenderState
+\brief An immutable block of the style parameters used by drawing
+objects. Blocks are interned by the display context, drawing objects
+that are created with the same style units reference one block.
+*/
+class RenderState {
+public:
+  RenderState() {}
+  RenderState(const CurrentUnits &units)
+      : pen(units.pen), textoutline(units.textoutline),
+        textfill(units.textfill), textshadow(units.textshadow),
+        font(units.font), align(units.align), background(units.background),
+        options(units.options) {}
+
+  std::shared_ptr<PEN> pen = nullptr;
+  std::shared_ptr<TEXTOUTLINE> textoutline = nullptr;
+  std::shared_ptr<TEXTFILL> textfill = nullptr;
+  std::shared_ptr<TEXTSHADOW> textshadow = nullptr;
+  std::shared_ptr<FONT> font = nullptr;
+  std::shared_ptr<ALIGN> align = nullptr;
+  std::shared_ptr<BACKGROUND> background = nullptr;
+  CairoOptionFn options = {};
+
+  // hash of the content of the units, set when the block is interned.
+  std::size_t contentHash = 0;
+  std::size_t hash(void) const;
+};
+typedef std::shared_ptr<const RenderState> RenderStatePtr;
+
+/**
+\internal
+\class DrawableIndex
+\brief spatial index of the drawing objects by ink rectangle.
+The plane is divided into a uniform grid, an object is listed within
+each cell its ink touches. Objects covering many cells are kept in a
+separate list that every query includes. Each object carries the order
+of its insertion so that a query returns candidates in drawing order.
+*/
+class DrawableIndex {
+public:
+  static constexpr int cellSize = 256;
+  static constexpr std::size_t largeCells = 64;
+
+  void insert(const std::shared_ptr<DrawingOutput> &obj);
+  void update(const std::shared_ptr<DrawingOutput> &obj);
+  void clear(void);
+  void query(const cairo_rectangle_int_t &r, DrawingOutputBatch &result);
+
+private:
+  void remove(DrawingOutput *obj);
+  void link(const std::shared_ptr<DrawingOutput> &obj);
+  static int cell(int v) {
+    return v >= 0 ? v / cellSize : -((cellSize - 1 - v) / cellSize);
+  }
+  static std::uint64_t cellKey(int col, int row) {
+    return (std::uint64_t)(std::uint32_t)col << 32 | (std::uint32_t)row;
+  }
+
+  std::unordered_map<std::uint64_t, DrawingOutputBatch> cells = {};
+  DrawingOutputBatch large = {};
+  // zero marks an object that has not been inserted.
+  std::uint64_t nextOrder = 1;
+  std::uint64_t queryStamp = 0;
+};
+
 class DisplayContext {
 public:
   class CairoRegion {
@@ -86,6 +162,14 @@ public:
       bOSsurface = false;
     }
 
+    CairoRegion(cairo_region_t *region) {
+      _ptr = cairo_region_reference(region);
+      cairo_region_get_extents(_ptr, &rect);
+      _rect = {(double)rect.x, (double)rect.y, (double)rect.width,
+               (double)rect.height};
+      bOSsurface = false;
+    }
+
     CairoRegion(const CairoRegion &other) { *this = other; }
     CairoRegion &operator=(const CairoRegion &other) {
       _ptr = cairo_region_reference(other._ptr);
@@ -130,6 +214,8 @@ public:
     visualType = other.visualType;
     syms = other.syms;
     xcbSurface = other.xcbSurface;
+    windowCr = other.windowCr;
+    backBuffer = other.backBuffer;
     preclear = other.preclear;
 
 #elif defined(_WIN64)
@@ -144,32 +230,50 @@ public:
     return *this;
   }
 
-  DrawingOutputCollection viewportOff = {};
-  std::atomic_flag drawables_off_readwrite = ATOMIC_FLAG_INIT;
-#define DRAWABLES_OFF_SPIN                                                     \
-  while (drawables_off_readwrite.test_and_set(std::memory_order_acquire))
-#define DRAWABLES_OFF_CLEAR                                                    \
-  drawables_off_readwrite.clear(std::memory_order_release)
-
-  DrawingOutputCollection viewportOn = {};
-  std::atomic_flag drawables_on_readwrite = ATOMIC_FLAG_INIT;
-#define DRAWABLES_ON_SPIN                                                      \
-  while (drawables_on_readwrite.test_and_set(std::memory_order_acquire))
-#define DRAWABLES_ON_CLEAR                                                     \
-  drawables_on_readwrite.clear(std::memory_order_release)
+  // every drawing object of the frame, on screen or not. objects are
+  // not moved as the viewport changes, the index answers which are
+  // within it.
+  DrawingOutputCollection drawables = {};
+  std::atomic_flag drawables_readwrite = ATOMIC_FLAG_INIT;
+#define DRAWABLES_SPIN                                                         \
+  while (drawables_readwrite.test_and_set(std::memory_order_acquire))
+#define DRAWABLES_CLEAR drawables_readwrite.clear(std::memory_order_release)
+
+  DrawableIndex viewportIndex = {};
+  std::atomic_flag lockViewportIndex = ATOMIC_FLAG_INIT;
+#define VIEWPORT_INDEX_SPIN                                                    \
+  while (lockViewportIndex.test_and_set(std::memory_order_acquire))
+#define VIEWPORT_INDEX_CLEAR lockViewportIndex.clear(std::memory_order_release)
+  void queryDrawables(const cairo_rectangle_int_t &r,
+                      DrawingOutputBatch &result) {
+    VIEWPORT_INDEX_SPIN;
+    viewportIndex.query(r, result);
+    VIEWPORT_INDEX_CLEAR;
+  }
 
   bool surfacePrime(void);
   void plot(CairoRegion &plotArea);
+  static std::vector<cairo_rectangle_int_t> simplify(cairo_region_t *region,
+                                                     std::size_t limit);
+  static std::size_t cull(DrawingOutputBatch &objects, cairo_region_t *damage);
   void flush(void);
+  void allocateBackBuffer(int w, int h);
+  void releaseBackBuffer(void);
+  void sharedMemory(bool b);
+  bool sharedMemory(void);
 
   void resizeSurface(const int w, const int h);
 
   void offsetPosition(const int x, const int y);
+  cairo_rectangle_int_t viewport(void);
   void surfaceBrush(Paint &b);
 
   void render(void);
   void addDrawable(std::shared_ptr<DrawingOutput> _obj);
-  void partitionVisibility(void);
+  void addDrawables(DrawingOutputBatch &_objs);
+  void update(std::shared_ptr<DrawingOutput> _obj,
+              const cairo_rectangle_int_t &previous);
+  void diffComplete(void);
   void state(std::shared_ptr<DrawingOutput> obj);
   void state(int x, int y, int w, int h);
   bool state(void);
@@ -178,6 +282,10 @@ public:
 
   DRAWBUFFER allocateBuffer(int width, int height);
   static void destroyBuffer(DRAWBUFFER &_buffer);
+  void cacheSurfaceBacking(cacheBacking b);
+  cacheBacking cacheSurfaceBacking(void) { return bufferBacking; }
+  void selectBacking(void);
+  cacheBacking measureBacking(void);
   void clear(void);
 
   std::atomic_flag lockErrors = ATOMIC_FLAG_INIT;
@@ -203,26 +311,49 @@ public:
   void setUnit(std::shared_ptr<AREA> _area) { currentUnits.area = _area; };
   void setUnit(std::shared_ptr<STRING> _text) { currentUnits.text = _text; };
   void setUnit(std::shared_ptr<IMAGE> _image) { currentUnits.image = _image; };
-  void setUnit(std::shared_ptr<FONT> _font) { currentUnits.font = _font; };
+  void setUnit(std::shared_ptr<FONT> _font) {
+    currentUnits.font = _font;
+    resetRenderState();
+  };
   void setUnit(std::shared_ptr<ANTIALIAS> _antialias) {
     currentUnits.antialias = _antialias;
   };
   void setUnit(std::shared_ptr<TEXTSHADOW> _textshadow) {
     currentUnits.textshadow = _textshadow;
+    resetRenderState();
   };
   void setUnit(std::shared_ptr<TEXTFILL> _textfill) {
     currentUnits.textfill = _textfill;
+    resetRenderState();
   };
   void setUnit(std::shared_ptr<TEXTOUTLINE> _textoutline) {
     currentUnits.textoutline = _textoutline;
+    resetRenderState();
+  };
+  void setUnit(std::shared_ptr<PEN> _pen) {
+    currentUnits.pen = _pen;
+    resetRenderState();
   };
-  void setUnit(std::shared_ptr<PEN> _pen) { currentUnits.pen = _pen; };
   void setUnit(std::shared_ptr<BACKGROUND> _background) {
     currentUnits.background = _background;
+    resetRenderState();
+  };
+  void setUnit(std::shared_ptr<ALIGN> _align) {
+    currentUnits.align = _align;
+    resetRenderState();
   };
-  void setUnit(std::shared_ptr<ALIGN> _align) { currentUnits.align = _align; };
   void setUnit(std::shared_ptr<EVENT> _event) { currentUnits.event = _event; };
 
+  // the render state block of the current style units. the block is
+  // looked up again only after a style unit has changed.
+  RenderStatePtr currentState(void) {
+    if (!_currentState)
+      _currentState = intern(RenderState(currentUnits));
+    return _currentState;
+  }
+  void resetRenderState(void) { _currentState.reset(); }
+  RenderStatePtr intern(const RenderState &s);
+
 public:
   short windowX = 0;
   short windowY = 0;
@@ -239,7 +370,79 @@ public:
 
   cairo_rectangle_t viewportRectangle = cairo_rectangle_t();
 
+  // when set, clear keeps the drawing objects of the previous frame.
+  // objects of the next frame with the same content take over their
+  // rendering and are not repainted.
+  std::atomic<bool> bDiffFrames = false;
+
+  // the damage of a frame is clipped with at most this many rectangles,
+  // zero uses the rectangles of the damaged region as they are.
+  std::atomic<std::size_t> maxDamageRectangles = 16;
+
+  // when set, frames are rendered as tiles by the renderer's workers.
+  std::atomic<TileRenderer *> tileRenderer = nullptr;
+
+  // objects not drawn as opaque objects above them cover the damage.
+  // accumulated by the renderers, taken by the frame clock.
+  std::atomic<std::size_t> culledDraws = 0;
+
+  // milliseconds an object stays off screen before its rendered buffer
+  // is released.
+  int releaseDelay = 500;
+
+  RasterCache rasterCache = {};
+
+  // set for a context that only provides another drawing surface, as the
+  // tiles of the tile renderer. work queued and buffers shared by draws
+  // through it go to the owner, its own pool and caches are not used.
+  DisplayContext *owner = nullptr;
+  DisplayContext &root(void) { return owner ? *owner : *this; }
+
+  // recordings published to the platform, they are work for the renderer
+  // until merged.
+  SubmissionQueue *submissions = nullptr;
+
+  // counts the caches against the budget and serves trim requests.
+  MemoryAccountant memory = {};
+
+  // the backing requested for the rendered buffers and the one in use.
+  // automatic is resolved once the window is open.
+  std::atomic<cacheBacking> requestedBacking = cacheBacking::automatic;
+  std::atomic<cacheBacking> bufferBacking = cacheBacking::image;
+
 private:
+  void moveViewport(const cairo_rectangle_int_t &previous,
+                    const cairo_rectangle_int_t &current);
+  void onscreen(const std::shared_ptr<DrawingOutput> &_obj, bool b);
+  void prepare(const std::shared_ptr<DrawingOutput> &_obj);
+  template <typename T> void trackPaint(const std::shared_ptr<T> &paint) {
+    if (!paint)
+      return;
+    T *p = paint.get();
+    memory.track({paint, [=]() { return p->imageBytes(); },
+                  [=]() { return p->lastUse(); },
+                  [=]() { p->releaseImage(); }});
+  }
+  void releaseCaches(void);
+  typedef struct _RELEASE {
+    std::shared_ptr<DrawingOutput> obj = nullptr;
+    std::chrono::steady_clock::time_point when = {};
+  } RELEASE;
+  std::list<RELEASE> _releases = {};
+  std::atomic_flag lockReleases = ATOMIC_FLAG_INIT;
+#define RELEASES_SPIN                                                          \
+  while (lockReleases.test_and_set(std::memory_order_acquire))
+#define RELEASES_CLEAR lockReleases.clear(std::memory_order_release)
+
+  bool reuse(std::shared_ptr<DrawingOutput> _obj);
+  std::unordered_multimap<std::size_t, std::shared_ptr<DrawingOutput>>
+      _previousFrame = {};
+  std::atomic_flag lockPreviousFrame = ATOMIC_FLAG_INIT;
+#define PREVIOUS_FRAME_SPIN                                                    \
+  while (lockPreviousFrame.test_and_set(std::memory_order_acquire))
+#define PREVIOUS_FRAME_CLEAR                                                   \
+  lockPreviousFrame.clear(std::memory_order_release)
+
   std::list<CairoRegion> _regions = {};
   typedef std::list<CairoRegion>::iterator RegionIter;
 
@@ -261,16 +464,29 @@ private:
 #define SURFACE_REQUESTS_CLEAR                                                 \
   lockSurfaceRequests.clear(std::memory_order_release)
 
+  RenderStatePtr _currentState = nullptr;
+  typedef std::vector<const void *> RenderStateKey;
+  std::map<RenderStateKey, std::weak_ptr<const RenderState>> _states = {};
+  std::size_t _statesPrune = 64;
+  std::atomic_flag lockStates = ATOMIC_FLAG_INIT;
+#define STATES_SPIN while (lockStates.test_and_set(std::memory_order_acquire))
+#define STATES_CLEAR lockStates.clear(std::memory_order_release)
+
+  // document position of the window origin, changed under the regions
+  // lock so that the damage of a frame and its position agree.
   int offsetx = 0, offsety = 0;
+  // document position the pixels of the window were rendered at. used
+  // by the render thread only.
+  int surfacex = 0, surfacey = 0;
+  void scrollSurface(const cairo_rectangle_int_t &view, cairo_region_t *damage,
+                     cairo_region_t *present);
+  void presentFrame(cairo_region_t *region);
   void applySurfaceRequests(void);
   std::mutex mutexRenderWork = {};
   std::condition_variable cvRenderWork = {};
 
 public:
 #if defined(__linux__)
-  // if render request time for objects are less than x ms
-  int cacheThreshold = 200;
-
   std::atomic<bool> bClearFrame = false;
   Display *xdisplay = nullptr;
   xcb_connection_t *connection = nullptr;
@@ -284,6 +500,28 @@ public:
   xcb_key_symbols_t *syms = nullptr;
 
   cairo_surface_t *xcbSurface = nullptr;
+  cairo_t *windowCr = nullptr;
+  // the composed frame. cr draws here, the window is updated from it
+  // and os paint requests are copied from it.
+  cairo_surface_t *backBuffer = nullptr;
+  // when set, the back buffer is placed in shared memory and presented
+  // with xcb_shm_put_image. the protocol is used if the server does not
+  // support it.
+  std::atomic<bool> bSharedMemory = false;
+  std::atomic<bool> bReallocateBuffer = false;
+
+  typedef struct _SHMSEGMENT {
+    xcb_shm_seg_t seg = 0;
+    void *addr = nullptr;
+    int width = 0;
+    int height = 0;
+  } SHMSEGMENT;
+  cairo_surface_t *allocateSharedBuffer(int w, int h, SHMSEGMENT &segment);
+  void releaseSharedBuffer(SHMSEGMENT &segment);
+  // the segment holding the back buffer when presenting through shared
+  // memory, changed with the back buffer under the xcb lock.
+  SHMSEGMENT shm = {};
+
   std::atomic_flag lockXCBSurface = ATOMIC_FLAG_INIT;
 #define XCB_SPIN while (lockXCBSurface.test_and_set(std::memory_order_acquire))
 #define XCB_CLEAR lockXCBSurface.clear(std::memory_order_release)
@@ -304,5 +542,10 @@ public:
   ID2D1Bitmap *pBitmap = nullptr;
 
 #endif
+
+public:
+  // background jobs of the objects. declared last so that the threads
+  // are stopped before the members the jobs use are destroyed.
+  WorkerPool workerPool = {};
 };
 } // namespace uxdevice
@@ -0,0 +1,187 @@
+/**
+\file uxdisplaylist.cpp
+
+\author Anthony Matarazzo
+
+\date 5/12/20
+\version 1.0
+
+\brief The module provides the arena that backs the display list and the
+queue through which recorded units reach it.
+
+*/
+#include "uxdevice.hpp"
+
+/**
+\internal
+\brief The routine returns aligned storage from the current block. When
+the request does not fit, the current block is retired and a new one is
+started. Requests that are large relative to the block size are given
+their own allocation.
+*/
+void *uxdevice::DisplayUnitArena::allocate(std::size_t n, std::size_t align) {
+  if (n > largeSize)
+    return ::operator new(n, std::align_val_t(align));
+
+  std::size_t start = (offset + align - 1) & ~(align - 1);
+  if (!block || start + n > blockSize) {
+    retire();
+    void *mem = std::aligned_alloc(blockSize, blockSize);
+    if (!mem)
+      throw std::bad_alloc();
+    block = new (mem) BLOCKHEADER();
+    block->released = releasedBytes;
+    offset = sizeof(BLOCKHEADER);
+    start = (offset + align - 1) & ~(align - 1);
+  }
+
+  block->live.fetch_add(1, std::memory_order_relaxed);
+  offset = start + n;
+  allocatedBytes += n;
+  return reinterpret_cast<char *>(block) + start;
+}
+
+/**
+\internal
+\brief The routine is called when a unit is destroyed. The header of the
+block is found by masking the address. Memory is not reused within a
+block, the whole block is freed when its live count reaches zero.
+This may occur on any thread.
+*/
+void uxdevice::DisplayUnitArena::deallocate(void *p, std::size_t n,
+                                            std::size_t align) noexcept {
+  if (n > largeSize) {
+    ::operator delete(p, std::align_val_t(align));
+    return;
+  }
+
+  BLOCKHEADER *header = reinterpret_cast<BLOCKHEADER *>(
+      reinterpret_cast<std::uintptr_t>(p) & ~(blockSize - 1));
+  release(header);
+}
+
+/**
+\internal
+\brief The routine drops the arena's reference to the current block.
+The next allocation starts a new block. Called by clear so that the
+previous generation is released as its units are destroyed.
+*/
+void uxdevice::DisplayUnitArena::retire(void) {
+  if (block)
+    release(block);
+  block = nullptr;
+  offset = 0;
+}
+
+/**
+\internal
+\brief decrements the live count and frees the block at zero. The size of
+the block is added to the counter of the arena that started it.
+*/
+void uxdevice::DisplayUnitArena::release(BLOCKHEADER *header) noexcept {
+  if (header->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    if (header->released)
+      *header->released += blockSize;
+    header->~BLOCKHEADER();
+    std::free(header);
+  }
+}
+
+/**
+\internal
+\brief The routine advances the compaction by up to slice units. A
+parameter unit held only by the list is neither current nor referenced by
+a drawing object or render state, so it is released. Kept units are moved
+down over the released ones. When the scan reaches the end of the index
+the vacated tail is removed and the next call starts a new pass. Returns
+the number of units released by this slice. Their memory is returned
+with their block, a block is kept while any of its units is held.
+*/
+std::size_t uxdevice::DisplayList::compact(std::size_t slice) {
+  std::size_t count = 0;
+  std::size_t end = std::min(units.size(), compactRead + slice);
+
+  for (; compactRead < end; compactRead++) {
+    std::shared_ptr<DisplayUnit> &unit = units[compactRead];
+    if (unit->isParameter() && unit.use_count() == 1) {
+      count++;
+      unit.reset();
+    } else {
+      if (compactWrite != compactRead)
+        units[compactWrite] = std::move(unit);
+      compactWrite++;
+    }
+  }
+
+  if (compactRead == units.size()) {
+    units.resize(compactWrite);
+    compactRead = 0;
+    compactWrite = 0;
+  }
+
+  return count;
+}
+
+/**
+\internal
+\brief releases chunks that were published but never merged.
+*/
+uxdevice::SubmissionQueue::~SubmissionQueue() {
+  SubmissionChunk *chunk = head.exchange(nullptr, std::memory_order_acquire);
+  while (chunk) {
+    SubmissionChunk *next = chunk->next;
+    delete chunk;
+    chunk = next;
+  }
+}
+
+/**
+\internal
+\brief publishes a chunk. The chunk is numbered and the queue takes
+ownership. Producers do not wait on each other or on the consumer.
+*/
+void uxdevice::SubmissionQueue::push(SubmissionChunk *chunk) {
+  chunk->sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+  chunk->next = head.load(std::memory_order_relaxed);
+  while (!head.compare_exchange_weak(chunk->next, chunk,
+                                     std::memory_order_release,
+                                     std::memory_order_relaxed))
+    ;
+}
+
+/**
+\internal
+\brief returns the next chunk in sequence order, or nullptr when it has
+not been published yet. Only one thread may consume at a time.
+*/
+std::unique_ptr<uxdevice::SubmissionChunk>
+uxdevice::SubmissionQueue::pop(void) {
+  if (pending.empty() || pending.begin()->first != expected) {
+    SubmissionChunk *chunk = head.exchange(nullptr, std::memory_order_acquire);
+    while (chunk) {
+      SubmissionChunk *next = chunk->next;
+      pending.emplace(chunk->sequence,
+                      std::unique_ptr<SubmissionChunk>(chunk));
+      chunk = next;
+    }
+  }
+
+  if (pending.empty() || pending.begin()->first != expected)
+    return nullptr;
+
+  std::unique_ptr<SubmissionChunk> ret = std::move(pending.begin()->second);
+  pending.erase(pending.begin());
+  ret->next = nullptr;
+  expected++;
+  return ret;
+}
+
+/**
+\internal
+\brief returns whether every chunk numbered so far has been handed out.
+A chunk being pushed counts once it holds its number. Only the consumer
+may call it.
+*/
+bool uxdevice::SubmissionQueue::empty(void) {
+  return nextSequence.load(std::memory_order_acquire) == expected;
+}
@@ -0,0 +1,220 @@
+/**
+\author Anthony Matarazzo
+\file uxdisplaylist.hpp
+\date 5/12/20
+\version 1.0
+ \details The display list storage. Units submitted through the platform
+ api are constructed inside of an arena that is carved into large blocks.
+ Submission is a bump pointer allocation and the shared pointer control
+ block lives next to the unit. Clearing the list retires the current
+ block generation, the memory of a block is released as a whole once the
+ last unit within it is destroyed. Producer threads may record units
+ into chunks of their own, the chunks are published through a lock free
+ queue and merged into the display list by the renderer.
+
+*/
+#pragma once
+
+namespace uxdevice {
+
+/**
+\internal
+\class DisplayUnitArena
+\brief bump pointer allocator for display units. Blocks are aligned to
+their size so that a unit's block header can be found from its address.
+Each block keeps a count of live allocations plus one reference held by
+the arena while the block is the current allocation target. A freed
+block adds its size to the released counter it was started with, the
+counter may be shared by the arenas whose units end in one list.
+*/
+class DisplayUnitArena {
+public:
+  static constexpr std::size_t blockSize = 64 * 1024;
+  static constexpr std::size_t largeSize = blockSize / 4;
+  typedef std::atomic<std::size_t> COUNTER;
+
+  DisplayUnitArena() {}
+  ~DisplayUnitArena() { retire(); }
+  DisplayUnitArena(const DisplayUnitArena &other) = delete;
+  DisplayUnitArena &operator=(const DisplayUnitArena &other) = delete;
+
+  void *allocate(std::size_t n, std::size_t align);
+  static void deallocate(void *p, std::size_t n, std::size_t align) noexcept;
+  void retire(void);
+
+  std::size_t bytes(void) { return allocatedBytes; }
+  std::size_t released(void) { return *releasedBytes; }
+
+  // blocks started from now on count their release in the counter.
+  void account(const std::shared_ptr<COUNTER> &counter) {
+    releasedBytes = counter;
+  }
+  const std::shared_ptr<COUNTER> &counter(void) { return releasedBytes; }
+
+private:
+  typedef struct _BLOCKHEADER {
+    std::atomic<std::size_t> live = 1;
+    std::shared_ptr<COUNTER> released = nullptr;
+  } BLOCKHEADER;
+
+  static void release(BLOCKHEADER *header) noexcept;
+
+  BLOCKHEADER *block = nullptr;
+  std::size_t offset = 0;
+  std::size_t allocatedBytes = 0;
+  std::shared_ptr<COUNTER> releasedBytes = std::make_shared<COUNTER>(0);
+};
+
+/**
+\internal
+\class ArenaAllocator
+\brief standard allocator interface over the display unit arena. It is
+used with std::allocate_shared so that both the unit and its control
+block come from the arena.
+*/
+template <typename T> class ArenaAllocator {
+public:
+  typedef T value_type;
+  ArenaAllocator(DisplayUnitArena *_arena) noexcept : arena(_arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+      : arena(other.arena) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *p, std::size_t n) noexcept {
+    DisplayUnitArena::deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  DisplayUnitArena *arena = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+  return a.arena == b.arena;
+}
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+  return a.arena != b.arena;
+}
+
+/**
+\internal
+\class DisplayList
+\brief the display list. Units are held in submission order within a
+contiguous index while the objects themselves are packed within the
+arena blocks. The emplace_back function returns the typed unit so the
+caller does not need to cast the result. Parameter units that have been
+superseded are released by compact. Their memory returns once every unit
+of their block is released, reclaimed counts the bytes of freed blocks.
+*/
+class DisplayList {
+public:
+  typedef std::vector<std::shared_ptr<DisplayUnit>> UnitIndex;
+  typedef UnitIndex::iterator iterator;
+
+  DisplayList() {}
+  DisplayList(const DisplayList &other) = delete;
+  DisplayList &operator=(const DisplayList &other) = delete;
+
+  template <typename T, typename... Args>
+  std::shared_ptr<T> emplace_back(Args &&... args) {
+    auto item = std::allocate_shared<T>(ArenaAllocator<T>(&arena),
+                                        std::forward<Args>(args)...);
+    item->tag = T::unitTag;
+    units.emplace_back(item);
+    return item;
+  }
+
+  void clear(void) {
+    units.clear();
+    arena.retire();
+    compactRead = 0;
+    compactWrite = 0;
+  }
+
+  // moves the units of another list to the end of this one. the blocks
+  // holding them stay alive through the units themselves.
+  void splice(DisplayList &other) {
+    units.reserve(units.size() + other.units.size());
+    std::move(other.units.begin(), other.units.end(),
+              std::back_inserter(units));
+    other.units.clear();
+  }
+
+  // the blocks of units recorded in this list and spliced into the
+  // other are counted by the other when they are freed.
+  void account(DisplayList &other) { arena.account(other.arena.counter()); }
+
+  std::size_t compact(std::size_t slice);
+  std::size_t reclaimed(void) { return arena.released(); }
+
+  iterator begin(void) { return units.begin(); }
+  iterator end(void) { return units.end(); }
+  std::size_t size(void) { return units.size(); }
+  bool empty(void) { return units.empty(); }
+
+private:
+  DisplayUnitArena arena = {};
+  UnitIndex units = {};
+
+  // position of the incremental compaction. entries between the write
+  // and read positions have been moved from and are empty.
+  std::size_t compactRead = 0;
+  std::size_t compactWrite = 0;
+};
+
+/**
+\internal
+\class SubmissionChunk
+\brief the units recorded by one producer. The units are constructed
+within the chunk's own list and are not applied to the context while
+recording. They are applied in order by invokeUnit when the chunk is
+merged.
+*/
+class SubmissionChunk {
+public:
+  SubmissionChunk() {}
+  SubmissionChunk(const SubmissionChunk &other) = delete;
+  SubmissionChunk &operator=(const SubmissionChunk &other) = delete;
+
+  // assigned by the queue when the chunk is published.
+  std::uint64_t sequence = 0;
+  SubmissionChunk *next = nullptr;
+  DisplayList units = {};
+  std::shared_ptr<COMMANDBUFFER> commands = nullptr;
+};
+
+/**
+\internal
+\class SubmissionQueue
+\brief multiple producer, single consumer queue of submission chunks.
+A finished chunk is given the next sequence number as it is pushed onto
+a lock free stack. The consumer takes the whole stack at once and hands
+out the chunks in sequence order, a chunk is held back until the ones
+numbered before it have been pushed. Numbers are only taken by chunks
+being published, a recording that is never ended does not hold back
+the others.
+*/
+class SubmissionQueue {
+public:
+  SubmissionQueue() {}
+  ~SubmissionQueue();
+  SubmissionQueue(const SubmissionQueue &other) = delete;
+  SubmissionQueue &operator=(const SubmissionQueue &other) = delete;
+
+  void push(SubmissionChunk *chunk);
+  std::unique_ptr<SubmissionChunk> pop(void);
+  bool empty(void);
+
+private:
+  std::atomic<SubmissionChunk *> head = nullptr;
+  std::atomic<std::uint64_t> nextSequence = 0;
+
+  // owned by the consumer.
+  std::uint64_t expected = 0;
+  std::map<std::uint64_t, std::unique_ptr<SubmissionChunk>> pending = {};
+};
+
+} // namespace uxdevice
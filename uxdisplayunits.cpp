@@ -45,65 +45,190 @@ void uxdevice::DrawingOutput::invoke(cairo_t *cr) {
   bprocessed = true;
 }
 
+/**
+\internal
+\brief compares the ink rectangle with r using integer arithmetic. The
+intersection is stored in out when the overlap is partial.
+*/
+static cairo_region_overlap_t
+overlapRectangle(const cairo_rectangle_int_t &ink,
+                 const cairo_rectangle_int_t &r, cairo_rectangle_int_t &out) {
+  int x0 = std::max(ink.x, r.x);
+  int y0 = std::max(ink.y, r.y);
+  int x1 = std::min(ink.x + ink.width, r.x + r.width);
+  int y1 = std::min(ink.y + ink.height, r.y + r.height);
+
+  if (x1 <= x0 || y1 <= y0)
+    return CAIRO_REGION_OVERLAP_OUT;
+
+  if (x0 == ink.x && y0 == ink.y && x1 == ink.x + ink.width &&
+      y1 == ink.y + ink.height)
+    return CAIRO_REGION_OVERLAP_IN;
+
+  out = {x0, y0, x1 - x0, y1 - y0};
+  return CAIRO_REGION_OVERLAP_PART;
+}
+
 void uxdevice::DrawingOutput::intersect(cairo_rectangle_t &r) {
   if (!hasInkExtents)
     return;
   cairo_rectangle_int_t rInt = {(int)r.x, (int)r.y, (int)r.width,
                                 (int)r.height};
-  cairo_region_t *rectregion = cairo_region_create_rectangle(&rInt);
-  cairo_rectangle_int_t objrect = {inkRectangle.x, inkRectangle.y,
-                                   inkRectangle.width, inkRectangle.height};
-
-  overlap = cairo_region_contains_rectangle(rectregion, &objrect);
-  if (overlap == CAIRO_REGION_OVERLAP_PART) {
-    cairo_region_t *dst = cairo_region_create_rectangle(&objrect);
-    cairo_region_intersect(dst, rectregion);
-    cairo_region_get_extents(dst, &intersection);
+
+  overlap = overlapRectangle(inkRectangle, rInt, intersection);
+  if (overlap == CAIRO_REGION_OVERLAP_PART)
     _intersection = {(double)intersection.x, (double)intersection.y,
                      (double)intersection.width, (double)intersection.height};
-    cairo_region_destroy(dst);
-  }
-
-  cairo_region_destroy(rectregion);
 }
+
+/**
+\internal
+\brief compares the ink rectangle with each rectangle of the region. The
+object is inside when one rectangle holds it, the intersection of a
+partial overlap is the bounds of the overlapping parts.
+*/
 void uxdevice::DrawingOutput::intersect(CairoRegion &rectregion) {
   if (!hasInkExtents)
     return;
 
-  cairo_region_t *dst = cairo_region_create_rectangle(&inkRectangle);
-  cairo_region_intersect(dst, rectregion._ptr);
-  cairo_region_get_extents(dst, &intersection);
+  overlap = CAIRO_REGION_OVERLAP_OUT;
+  int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+
+  int n = cairo_region_num_rectangles(rectregion._ptr);
+  for (int i = 0; i < n; i++) {
+    cairo_rectangle_int_t r, part;
+    cairo_region_get_rectangle(rectregion._ptr, i, &r);
+    switch (overlapRectangle(inkRectangle, r, part)) {
+    case CAIRO_REGION_OVERLAP_OUT:
+      break;
+    case CAIRO_REGION_OVERLAP_IN:
+      overlap = CAIRO_REGION_OVERLAP_IN;
+      return;
+    case CAIRO_REGION_OVERLAP_PART:
+      overlap = CAIRO_REGION_OVERLAP_PART;
+      x0 = std::min(x0, part.x);
+      y0 = std::min(y0, part.y);
+      x1 = std::max(x1, part.x + part.width);
+      y1 = std::max(y1, part.y + part.height);
+      break;
+    }
+  }
+
+  if (overlap != CAIRO_REGION_OVERLAP_PART)
+    return;
+
+  intersection = {x0, y0, x1 - x0, y1 - y0};
   _intersection = {(double)intersection.x, (double)intersection.y,
                    (double)intersection.width, (double)intersection.height};
-  cairo_region_destroy(dst);
 }
 
-void uxdevice::DrawingOutput::evaluateCache(DisplayContext &context) {
-  return;
-  if (bRenderBufferCached) {
-    lastRenderTime = std::chrono::high_resolution_clock::now();
-    if (oncethread)
-      oncethread.reset();
-    return;
-  }
+/**
+\internal
+\brief The routine takes over the rendered buffer of an object from the
+previous frame that has the same content. The other object is being
+discarded, its drawing functions are emptied under its lock so that a
+draw in progress elsewhere does not use the buffer once moved.
+*/
+void uxdevice::DrawingOutput::adopt(DrawingOutput &other) {
+  using namespace std::placeholders;
 
-  // evaluate Rendering from cache
-  if (bFirstTimeRendered) {
-    bFirstTimeRendered = false;
-
-  } else if (!oncethread) {
-    auto currentPoint = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> diff =
-        currentPoint - lastRenderTime;
-    // if rendering requests are for more than 2 frames
-    bool useCache = diff.count() < context.cacheThreshold;
-    if (useCache) {
-      oncethread = std::make_unique<std::thread>(
-          [=, &context]() { fnCacheSurface(context); });
-      oncethread->detach();
-    }
+  auto fnNone = [=](DisplayContext &context) {};
+  other.functorsLock(true);
+  bool bCached = other.bRenderBufferCached && other._buf.rendered;
+  if (bCached) {
+    _buf = other._buf;
+    other._buf = {};
+    other.bRenderBufferCached = false;
   }
-  lastRenderTime = std::chrono::high_resolution_clock::now();
+  other.fnDraw = std::bind(fnNone, _1);
+  other.fnDrawClipped = std::bind(fnNone, _1);
+  other.functorsLock(false);
+
+  if (!bCached)
+    return;
+
+  auto drawfn = [=](DisplayContext &context) {
+    DrawingOutput::invoke(context.cr);
+    cairo_set_source_surface(context.cr, _buf.rendered, _inkRectangle.x,
+                             _inkRectangle.y);
+    cairo_rectangle(context.cr, _inkRectangle.x, _inkRectangle.y,
+                    _inkRectangle.width, _inkRectangle.height);
+    cairo_fill(context.cr);
+  };
+  auto fnClipping = [=](DisplayContext &context) {
+    DrawingOutput::invoke(context.cr);
+    cairo_set_source_surface(context.cr, _buf.rendered, _inkRectangle.x,
+                             _inkRectangle.y);
+    cairo_rectangle(context.cr, _intersection.x, _intersection.y,
+                    _intersection.width, _intersection.height);
+    cairo_fill(context.cr);
+  };
+  functorsLock(true);
+  fnDraw = std::bind(drawfn, _1);
+  fnDrawClipped = std::bind(fnClipping, _1);
+  functorsLock(false);
+  bRenderBufferCached = true;
+}
+
+/**
+\internal
+\brief The routine releases the rendered buffer of an object that has
+left the viewport or was evicted by the raster cache. The base function
+draws directly and frees the buffer, it is created again if the object
+is cached later.
+*/
+void uxdevice::DrawingOutput::releaseCache(DisplayContext &context) {
+  if (!bRenderBufferCached)
+    return;
+  functorsLock(true);
+  DrawLogic fn = _buf.rendered ? fnBaseSurface : DrawLogic();
+  functorsLock(false);
+  if (fn)
+    fn(context);
+}
+
+/**
+\internal
+\brief returns the key the rendered buffer is shared under. The buffer
+is sized by the ink area, which is part of the key.
+*/
+std::size_t uxdevice::DrawingOutput::bufferKey(void) {
+  if (!visualHash)
+    return 0;
+  std::size_t key = visualHash;
+  hashCombine(key, inkRectangle.width);
+  hashCombine(key, inkRectangle.height);
+  return key;
+}
+
+/**
+\internal
+\brief The routine takes a reference to the buffer rendered by an equal
+object. Returns false when there is none and the object renders its own.
+*/
+bool uxdevice::DrawingOutput::sharedBuffer(DisplayContext &context,
+                                           DRAWBUFFER &buf) {
+  cairo_surface_t *rendered = context.root().rasterCache.shared(bufferKey());
+  if (!rendered)
+    return false;
+  buf = DRAWBUFFER{nullptr, rendered};
+  return true;
+}
+
+/**
+\internal
+\brief The routine offers the rendered buffer to equal objects. When an
+equal object offered its buffer first, as both were rendered at once,
+that buffer is used and this one freed.
+*/
+void uxdevice::DrawingOutput::shareBuffer(DisplayContext &context,
+                                          DRAWBUFFER &buf) {
+  cairo_surface_t *rendered =
+      context.root().rasterCache.share(bufferKey(), buf.rendered);
+  if (!rendered)
+    return;
+  context.destroyBuffer(buf);
+  buf = DRAWBUFFER{nullptr, rendered};
 }
 
 void uxdevice::OPTION_FUNCTION::invoke(DisplayContext &context) {
@@ -113,7 +238,121 @@ void uxdevice::OPTION_FUNCTION::invoke(DisplayContext &context) {
     return n->fnOption.target_type().hash_code() == optType;
   });
 
-  context.currentUnits.options.emplace_back(this);
+  context.currentUnits.options.emplace_back(shared_from_this());
+  context.resetRenderState();
+}
+
+/**
+\internal
+\brief replays the command stream against the cairo context. The
+operand count of each opcode is fixed, operands are copied out of the
+stream as they are not aligned.
+*/
+void uxdevice::COMMANDBUFFER::replay(cairo_t *cr) {
+  const std::uint8_t *p = stream.data();
+  const std::uint8_t *end = p + stream.size();
+  double d[maxOperands];
+
+  while (p < end) {
+    opcode op = static_cast<opcode>(*p++);
+    std::size_t n = operandCount[static_cast<std::size_t>(op)];
+    std::memcpy(d, p, n * sizeof(double));
+    p += n * sizeof(double);
+
+    switch (op) {
+    case opcode::save:
+      cairo_save(cr);
+      break;
+    case opcode::restore:
+      cairo_restore(cr);
+      break;
+    case opcode::translate:
+      cairo_translate(cr, d[0], d[1]);
+      break;
+    case opcode::rotate:
+      cairo_rotate(cr, d[0]);
+      break;
+    case opcode::scale:
+      cairo_scale(cr, d[0], d[1]);
+      break;
+    case opcode::identity:
+      cairo_identity_matrix(cr);
+      break;
+    case opcode::arc:
+      cairo_arc(cr, d[0], d[1], d[2], d[3], d[4]);
+      break;
+    case opcode::arcNegative:
+      cairo_arc_negative(cr, d[0], d[1], d[2], d[3], d[4]);
+      break;
+    case opcode::curve:
+      cairo_curve_to(cr, d[0], d[1], d[2], d[3], d[4], d[5]);
+      break;
+    case opcode::relCurve:
+      cairo_rel_curve_to(cr, d[0], d[1], d[2], d[3], d[4], d[5]);
+      break;
+    case opcode::line:
+      cairo_line_to(cr, d[0], d[1]);
+      break;
+    case opcode::relLine:
+      cairo_rel_line_to(cr, d[0], d[1]);
+      break;
+    case opcode::move:
+      cairo_move_to(cr, d[0], d[1]);
+      break;
+    case opcode::relMove:
+      cairo_rel_move_to(cr, d[0], d[1]);
+      break;
+    case opcode::rectangle:
+      cairo_rectangle(cr, d[0], d[1], d[2], d[3]);
+      break;
+    }
+  }
+}
+
+/**
+\internal
+\brief checks a command stream read from outside, such as a snapshot,
+before it is replayed. Every opcode must be known and its operands must
+lie within the stream.
+*/
+bool uxdevice::COMMANDBUFFER::valid(const std::uint8_t *data, std::size_t n) {
+  std::size_t i = 0;
+  while (i < n) {
+    std::size_t op = data[i++];
+    if (op >= sizeof(operandCount))
+      return false;
+    std::size_t bytes = operandCount[op] * sizeof(double);
+    if (bytes > n - i)
+      return false;
+    i += bytes;
+  }
+  return true;
+}
+
+std::size_t uxdevice::AREA::hash(void) {
+  std::size_t value = 0;
+  hashCombine(value, type);
+  hashCombine(value, x);
+  hashCombine(value, y);
+  hashCombine(value, w);
+  hashCombine(value, h);
+  hashCombine(value, rx);
+  hashCombine(value, ry);
+  return value;
+}
+
+/**
+\internal
+\brief hashes the shape of the area without its position.
+*/
+std::size_t uxdevice::AREA::shapeHash(void) {
+  std::size_t value = 0;
+  hashCombine(value, type);
+  hashCombine(value, w);
+  hashCombine(value, h);
+  hashCombine(value, rx);
+  hashCombine(value, ry);
+  return value;
 }
 
 void uxdevice::AREA::shrink(double a) {
@@ -175,11 +414,12 @@ bool uxdevice::DRAWTEXT::setLayoutOptions(cairo_t *cr) {
   const PangoFontDescription *originalDescription =
       pango_layout_get_font_description(layout);
   if (!originalDescription ||
-      !pango_font_description_equal(originalDescription, font->fontDescription))
-    pango_layout_set_font_description(layout, font->fontDescription);
+      !pango_font_description_equal(originalDescription,
+                                    state->font->fontDescription))
+    pango_layout_set_font_description(layout, state->font->fontDescription);
 
-  if (align) {
-    align->emit(layout);
+  if (state->align) {
+    state->align->emit(layout);
   }
 
   // set the width and height of the layout.
@@ -212,28 +452,88 @@ bool uxdevice::DRAWTEXT::setLayoutOptions(cairo_t *cr) {
 void uxdevice::DRAWTEXT::createShadow(void) {
   if (!shadowImage) {
     shadowImage = cairo_image_surface_create(
-        CAIRO_FORMAT_ARGB32, _inkRectangle.width + textshadow->x,
-        _inkRectangle.height + textshadow->y);
+        CAIRO_FORMAT_ARGB32, _inkRectangle.width + state->textshadow->x,
+        _inkRectangle.height + state->textshadow->y);
     shadowCr = cairo_create(shadowImage);
     // offset text by the parameter amounts
-    cairo_move_to(shadowCr, textshadow->x, textshadow->y);
+    cairo_move_to(shadowCr, state->textshadow->x, state->textshadow->y);
     if (setLayoutOptions(shadowCr))
       pango_cairo_update_layout(shadowCr, layout);
-    textshadow->emit(shadowCr);
+    state->textshadow->emit(shadowCr);
 
     pango_cairo_show_layout(shadowCr, layout);
 
 #if defined(USE_STACKBLUR)
-    blurImage(shadowImage, textshadow->radius);
+    blurImage(shadowImage, state->textshadow->radius);
 
 #elif defined(USE_SVGREN)
-    cairo_surface_t *blurred = blurImage(shadowImage, textshadow->radius);
+    cairo_surface_t *blurred =
+        blurImage(shadowImage, state->textshadow->radius);
     cairo_surface_destroy(shadowImage);
     shadowImage = blurred;
 #endif
   }
 }
 
+/**
+\internal
+\brief returns the bytes of the blurred shadow.
+*/
+std::size_t uxdevice::DRAWTEXT::shadowBytes(void) {
+  functorsLock(true);
+  std::size_t ret = 0;
+  if (shadowImage)
+    ret = cairo_image_surface_get_stride(shadowImage) *
+          cairo_image_surface_get_height(shadowImage);
+  functorsLock(false);
+  return ret;
+}
+
+/**
+\internal
+\brief frees the blurred shadow. The next draw that needs it creates it
+again.
+*/
+void uxdevice::DRAWTEXT::releaseShadow(void) {
+  functorsLock(true);
+  destroyShadow();
+  functorsLock(false);
+}
+
+/**
+\internal
+\brief frees the blurred shadow. The functors lock is held by the caller.
+*/
+void uxdevice::DRAWTEXT::destroyShadow(void) {
+  if (shadowImage) {
+    cairo_surface_destroy(shadowImage);
+    shadowImage = nullptr;
+  }
+  if (shadowCr) {
+    cairo_destroy(shadowCr);
+    shadowCr = nullptr;
+  }
+}
+
+/**
+\internal
+\brief takes over the blurred shadow as well as the rendered buffer.
+*/
+void uxdevice::DRAWTEXT::adopt(DrawingOutput &other) {
+  DRAWTEXT &o = static_cast<DRAWTEXT &>(other);
+
+  o.functorsLock(true);
+  functorsLock(true);
+  if (!shadowImage && o.shadowImage) {
+    shadowImage = o.shadowImage.exchange(nullptr);
+    shadowCr = o.shadowCr.exchange(nullptr);
+  }
+  functorsLock(false);
+  o.functorsLock(false);
+
+  DrawingOutput::adopt(other);
+}
+
 /**
 \internal
 \brief
@@ -241,20 +541,32 @@ void uxdevice::DRAWTEXT::createShadow(void) {
 
 */
 void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
-  using namespace std::placeholders;
-
-  pen = context.currentUnits.pen;
-  textoutline = context.currentUnits.textoutline;
-  textfill = context.currentUnits.textfill;
-  textshadow = context.currentUnits.textshadow;
+  state = context.currentState();
   area = context.currentUnits.area;
   text = context.currentUnits.text;
-  font = context.currentUnits.font;
-  align = context.currentUnits.align;
-  options = context.currentUnits.options;
+  build(context);
+}
+
+/**
+\internal
+\brief creates the drawing functions from the parameters held by the
+object. Called at submission and again when a parameter is replaced
+through a drawable handle. The shadow is regenerated as it depends on
+the text. The functors lock is held while the layout and the functions
+are replaced, a cache job of the worker pool uses them under the lock.
+*/
+void uxdevice::DRAWTEXT::build(DisplayContext &context) {
+  using namespace std::placeholders;
+
+  functorsLock(true);
+  std::uint64_t generation = ++buildGeneration;
+  destroyShadow();
+  contentHash = 0;
+  visualHash = 0;
 
   // check the context parameters before operating
-  if (!((pen || textoutline || textfill) && area && text && font)) {
+  if (!(state && (state->pen || state->textoutline || state->textfill) &&
+        area && text && state->font)) {
     const char *s = "A draw text object must include the following "
                     "attributes. A pen or a textoutline or "
                     " textfill. As well, an area, text and font";
@@ -265,8 +577,18 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
     fnCacheSurface = std::bind(fn, _1);
     fnDraw = std::bind(fn, _1);
     fnDrawClipped = std::bind(fn, _1);
+    functorsLock(false);
     return;
   }
+  hashCombine(contentHash, 1);
+  hashCombine(contentHash, area->hash());
+  hashCombine(contentHash, text->data);
+  hashCombine(contentHash, state->contentHash);
+  hashCombine(visualHash, 1);
+  hashCombine(visualHash, area->shapeHash());
+  hashCombine(visualHash, text->data);
+  hashCombine(visualHash, state->contentHash);
+
   // not using the path layout is faster
   // these options change rendering and pango api usage
   bool bUsePathLayout = false;
@@ -274,13 +596,13 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
   bool bFilled = false;
 
   // if the text is drawn with an outline
-  if (textoutline) {
+  if (state->textoutline) {
     bUsePathLayout = true;
     bOutline = true;
   }
 
   // if the text is filled with a texture or gradient
-  if (textfill) {
+  if (state->textfill) {
     bFilled = true;
     bUsePathLayout = true;
   }
@@ -288,7 +610,7 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
   std::function<void(cairo_t * cr, AREA & a)> fnShadow;
   std::function<void(cairo_t * cr, AREA & a)> fn;
 
-  if (textshadow) {
+  if (state->textshadow) {
     fnShadow = [=](cairo_t *cr, AREA &a) {
       createShadow();
       cairo_set_source_surface(cr, shadowImage, a.x, a.y);
@@ -313,9 +635,9 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
         fnShadow(cr, a);
         cairo_move_to(cr, a.x, a.y);
         pango_cairo_layout_path(cr, layout);
-        textfill->emit(cr, a.x, a.y, a.w, a.h);
+        state->textfill->emit(cr, a.x, a.y, a.w, a.h);
         cairo_fill_preserve(cr);
-        textoutline->emit(cr, a.x, a.y, a.w, a.h);
+        state->textoutline->emit(cr, a.x, a.y, a.w, a.h);
         cairo_stroke(cr);
       };
 
@@ -328,7 +650,7 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
         fnShadow(cr, a);
         cairo_move_to(cr, a.x, a.y);
         pango_cairo_layout_path(cr, layout);
-        textfill->emit(cr, a.x, a.y, a.w, a.h);
+        state->textfill->emit(cr, a.x, a.y, a.w, a.h);
         cairo_fill(cr);
       };
 
@@ -341,7 +663,7 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
         fnShadow(cr, a);
         cairo_move_to(cr, a.x, a.y);
         pango_cairo_layout_path(cr, layout);
-        textoutline->emit(cr, a.x, a.y, a.w, a.h);
+        state->textoutline->emit(cr, a.x, a.y, a.w, a.h);
         cairo_stroke(cr);
       };
     }
@@ -358,7 +680,7 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
         pango_cairo_update_layout(cr, layout);
       fnShadow(cr, a);
       cairo_move_to(cr, a.x, a.y);
-      pen->emit(cr, a.x, a.y, a.w, a.h);
+      state->pen->emit(cr, a.x, a.y, a.w, a.h);
       pango_cairo_show_layout(cr, layout);
     };
   }
@@ -368,33 +690,50 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
     if (bRenderBufferCached)
       return;
 
-    // create off screen buffer
-    context.lock(true);
-    setLayoutOptions(context.cr);
-    context.lock(false);
+    // the buffer is rendered aside and published with the draw functions
+    // under the lock, the render thread reads it while this runs.
+    DRAWBUFFER buf = {};
+
+    // equal text elsewhere may have been rendered already.
+    if (!sharedBuffer(context, buf)) {
+      // the layout and shadow are shared with the draws of the renderers,
+      // the buffer may be rendered by the worker pool while they draw.
+      functorsLock(true);
+      if (generation != buildGeneration) {
+        functorsLock(false);
+        return;
+      }
 
-    ERROR_CHECK(context.cr);
+      // create off screen buffer
+      context.lock(true);
+      setLayoutOptions(context.cr);
+      context.lock(false);
 
-    _buf = context.allocateBuffer(_inkRectangle.width, _inkRectangle.height);
+      ERROR_CHECK(context.cr);
 
-    setLayoutOptions(_buf.cr);
-    ERROR_CHECK(_buf.cr);
+      buf = context.allocateBuffer(_inkRectangle.width, _inkRectangle.height);
 
-    AREA a = *area;
+      setLayoutOptions(buf.cr);
+      ERROR_CHECK(buf.cr);
+
+      AREA a = *area;
 #if 0
-    if(textfill)
-      textfill->translate(-a.x,-a.y);
-    if(textoutline)
-      textoutline->translate(-a.x,-a.y);
+      if(state->textfill)
+        state->textfill->translate(-a.x,-a.y);
+      if(state->textoutline)
+        state->textoutline->translate(-a.x,-a.y);
 #endif // 0
-    a.x = 0;
-    a.y = 0;
+      a.x = 0;
+      a.y = 0;
 
-    fn(_buf.cr, a);
-    ERROR_CHECK(_buf.cr);
+      fn(buf.cr, a);
+      functorsLock(false);
+      ERROR_CHECK(buf.cr);
 
-    cairo_surface_flush(_buf.rendered);
-    ERROR_CHECK(_buf.rendered);
+      cairo_surface_flush(buf.rendered);
+      ERROR_CHECK(buf.rendered);
+      shareBuffer(context, buf);
+    }
 
     auto drawfn = [=](DisplayContext &context) {
       DrawingOutput::invoke(context.cr);
@@ -414,10 +753,16 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
       cairo_fill(context.cr);
     };
     functorsLock(true);
+    if (generation != buildGeneration) {
+      functorsLock(false);
+      context.destroyBuffer(buf);
+      return;
+    }
+    _buf = buf;
     fnDraw = std::bind(drawfn, _1);
     fnDrawClipped = std::bind(fnClipping, _1);
-    functorsLock(false);
     bRenderBufferCached = true;
+    functorsLock(false);
   };
 
   // two function provide mode switching for the rendering.
@@ -432,38 +777,43 @@ void uxdevice::DRAWTEXT::invoke(DisplayContext &context) {
     auto drawfn = [=](DisplayContext &context) {
       DrawingOutput::invoke(context.cr);
       fn(context.cr, *area);
-      evaluateCache(context);
     };
     auto fnClipping = [=](DisplayContext &context) {
+      cairo_save(context.cr);
       cairo_rectangle(context.cr, _intersection.x, _intersection.y,
                       _intersection.width, _intersection.height);
       cairo_clip(context.cr);
       DrawingOutput::invoke(context.cr);
       fn(context.cr, *area);
-      cairo_reset_clip(context.cr);
-      evaluateCache(context);
+      cairo_restore(context.cr);
     };
+    DRAWBUFFER buf = {};
     functorsLock(true);
     fnDraw = std::bind(drawfn, _1);
     fnDrawClipped = std::bind(fnClipping, _1);
-    functorsLock(false);
     if (bRenderBufferCached) {
-      context.destroyBuffer(_buf);
+      buf = _buf;
+      _buf = {};
       bRenderBufferCached = false;
     }
+    functorsLock(false);
+    context.destroyBuffer(buf);
   };
   context.lock(true);
   setLayoutOptions(context.cr);
   context.lock(false);
   fnBaseSurface = fnBase;
-  fnBaseSurface(context);
+  functorsLock(false);
+  fnBase(context);
 
   bprocessed = true;
 }
 
 /**
 \internal
-\brief reads the image and creates a cairo surface image.
+\brief queues the reading of the image to the worker pool. The image is
+sized to the current area. An image not held by a shared pointer is read
+at once.
 */
 void uxdevice::IMAGE::invoke(DisplayContext &context) {
 
@@ -476,20 +826,105 @@ void uxdevice::IMAGE::invoke(DisplayContext &context) {
     return;
   }
 
-  auto fnthread = [=, &context]() {
-    _image = readImage(_data, area->w, area->h);
+  std::weak_ptr<IMAGE> owner = weak_from_this();
+  bLoading = true;
+  if (owner.expired())
+    load(context);
+  else
+    context.workerPool.submit(WorkerPool::jobPriority::visible, owner,
+                              [=, &context]() { load(context); });
+  bprocessed = true;
+}
 
-    if (_image)
-      bLoaded = true;
-    else {
-      const char *s = "The image could not be processed or loaded. ";
-      ERROR_DRAW_PARAM(s);
-      ERROR_DESC(_data);
-    }
-  };
+/**
+\internal
+\brief queues the image to be read again after the memory accountant
+released it. Called by the draws that find it missing.
+*/
+void uxdevice::IMAGE::reload(DisplayContext &context) {
+  if (bLoaded || bLoading.exchange(true))
+    return;
+  DisplayContext &target = context.root();
+  target.workerPool.submit(WorkerPool::jobPriority::visible, weak_from_this(),
+                           [=, &target]() { load(target); });
+}
 
-  fnthread();
-  bprocessed = true;
+/**
+\internal
+\brief reads the image and creates a cairo surface image. Once loaded,
+the area the image was sized for is painted again.
+*/
+void uxdevice::IMAGE::load(DisplayContext &context) {
+  cairo_surface_t *image = readImage(_data, area->w, area->h);
+
+  if (!image) {
+    const char *s = "The image could not be processed or loaded. ";
+    ERROR_DRAW_PARAM(s);
+    ERROR_DESC(_data);
+    bLoading = false;
+    return;
+  }
+
+  IMAGE_SPIN;
+  _image = image;
+  bLoaded = true;
+  IMAGE_CLEAR;
+  bLoading = false;
+
+  // images held by the display list may be released to fit the budget.
+  std::weak_ptr<IMAGE> owner = weak_from_this();
+  if (!owner.expired())
+    context.memory.track(MemoryAccountant::RESOURCE{
+        owner, [=]() { return bytes(); }, [=]() { return lastUse.load(); },
+        [=]() { release(); }});
+
+  context.state(area->x, area->y, area->w, area->h);
+  context.stateNotifyComplete();
+}
+
+/**
+\internal
+\brief sets the image as the source of the cairo context. Returns false
+when the image is not loaded.
+*/
+bool uxdevice::IMAGE::emit(cairo_t *cr, double x, double y) {
+  IMAGE_SPIN;
+  bool ret = _image != nullptr;
+  if (ret)
+    cairo_set_source_surface(cr, _image, x, y);
+  IMAGE_CLEAR;
+  if (ret)
+    lastUse = MemoryAccountant::now();
+  return ret;
+}
+
+/**
+\internal
+\brief returns the bytes of the decoded image.
+*/
+std::size_t uxdevice::IMAGE::bytes(void) {
+  IMAGE_SPIN;
+  std::size_t ret = 0;
+  if (_image)
+    ret = cairo_image_surface_get_stride(_image) *
+          cairo_image_surface_get_height(_image);
+  IMAGE_CLEAR;
+  return ret;
+}
+
+/**
+\internal
+\brief frees the decoded image. A draw in progress holds its own
+reference through the cairo context.
+*/
+void uxdevice::IMAGE::release(void) {
+  IMAGE_SPIN;
+  cairo_surface_t *image = _image;
+  _image = nullptr;
+  bLoaded = false;
+  IMAGE_CLEAR;
+  if (image)
+    cairo_surface_destroy(image);
 }
 
 /**
@@ -497,11 +932,20 @@ void uxdevice::IMAGE::invoke(DisplayContext &context) {
 \brief
 */
 void uxdevice::DRAWIMAGE::invoke(DisplayContext &context) {
-  using namespace std::placeholders;
-
   area = context.currentUnits.area;
   image = context.currentUnits.image;
-  options = context.currentUnits.options;
+  state = context.currentState();
+  build(context);
+}
+
+/**
+\internal
+\brief creates the drawing functions from the area and image.
+*/
+void uxdevice::DRAWIMAGE::build(DisplayContext &context) {
+  using namespace std::placeholders;
+  contentHash = 0;
+
   if (!(area && image && image->valid())) {
     const char *s = "A draw image object must include the following "
                     "attributes. A an area and an image.";
@@ -510,10 +954,16 @@ void uxdevice::DRAWIMAGE::invoke(DisplayContext &context) {
 
     fnBaseSurface = std::bind(fn, _1);
     fnCacheSurface = std::bind(fn, _1);
+    functorsLock(true);
     fnDraw = std::bind(fn, _1);
     fnDrawClipped = std::bind(fn, _1);
+    functorsLock(false);
     return;
   }
+  hashCombine(contentHash, 2);
+  hashCombine(contentHash, area->hash());
+  hashCombine(contentHash, image->_data);
+
   // set the ink area.
   const AREA &a = *area;
   inkRectangle = {(int)a.x, (int)a.y, (int)a.w, (int)a.h};
@@ -521,12 +971,19 @@ void uxdevice::DRAWIMAGE::invoke(DisplayContext &context) {
                    (double)inkRectangle.width, (double)inkRectangle.height};
   hasInkExtents = true;
   auto fnCache = [=](DisplayContext &context) {
+    // the draws may run on renderer contexts, an image that was released
+    // is read again through the pool of this one.
+    DisplayContext *loader = &context.root();
+
     // set directly callable rendering function.
     auto fn = [=](DisplayContext &context) {
       if (!image->valid())
         return;
       DrawingOutput::invoke(context.cr);
-      cairo_set_source_surface(context.cr, image->_image, a.x, a.y);
+      if (!image->emit(context.cr, a.x, a.y)) {
+        image->reload(*loader);
+        return;
+      }
       cairo_rectangle(context.cr, a.x, a.y, a.w, a.h);
       cairo_fill(context.cr);
     };
@@ -534,7 +991,10 @@ void uxdevice::DRAWIMAGE::invoke(DisplayContext &context) {
       if (!image->valid())
         return;
       DrawingOutput::invoke(context.cr);
-      cairo_set_source_surface(context.cr, image->_image, a.x, a.y);
+      if (!image->emit(context.cr, a.x, a.y)) {
+        image->reload(*loader);
+        return;
+      }
       cairo_rectangle(context.cr, _intersection.x, _intersection.y,
                       _intersection.width, _intersection.height);
       cairo_fill(context.cr);
@@ -562,15 +1022,30 @@ void uxdevice::DRAWIMAGE::invoke(DisplayContext &context) {
 \brief
 */
 void uxdevice::DRAWAREA::invoke(DisplayContext &context) {
+  state = context.currentState();
+  area = context.currentUnits.area;
+  build(context);
+}
+
+/**
+\internal
+\brief creates the drawing functions from the area, background and pen.
+The shape and painting steps are selected here so a replaced parameter
+takes effect on the next build.
+*/
+void uxdevice::DRAWAREA::build(DisplayContext &context) {
   using namespace std::placeholders;
 
-  area = context.currentUnits.area;
-  background = context.currentUnits.background;
-  pen = context.currentUnits.pen;
-  options = context.currentUnits.options;
+  // the functions are replaced under the lock, a cache job of the worker
+  // pool may be rendering with them.
+  functorsLock(true);
+  std::uint64_t generation = ++buildGeneration;
+  contentHash = 0;
+  visualHash = 0;
+  bOpaque = false;
 
   // check the context before operating
-  if (!(area && (background || pen))) {
+  if (!(area && state && (state->background || state->pen))) {
     const char *s =
         "The draw area command requires an area to be defined. As well"
         "a background, or a pen.";
@@ -581,8 +1056,15 @@ void uxdevice::DRAWAREA::invoke(DisplayContext &context) {
     fnCacheSurface = std::bind(fn, _1);
     fnDraw = std::bind(fn, _1);
     fnDrawClipped = std::bind(fn, _1);
+    functorsLock(false);
     return;
   }
+  hashCombine(contentHash, 3);
+  hashCombine(contentHash, area->hash());
+  hashCombine(contentHash, state->contentHash);
+  hashCombine(visualHash, 3);
+  hashCombine(visualHash, area->shapeHash());
+  hashCombine(visualHash, state->contentHash);
 
   // set the ink area.
   const AREA &bounds = *area;
@@ -613,35 +1095,50 @@ void uxdevice::DRAWAREA::invoke(DisplayContext &context) {
                    (double)inkRectangle.width, (double)inkRectangle.height};
   hasInkExtents = true;
 
+  // a rectangle filled with an opaque paint covers the whole pixels
+  // within it. the outline, when present, must be opaque as well as
+  // the fill is shrunk by half of the line width.
+  if (bounds.type == areaType::rectangle && state->background &&
+      state->options.empty() && state->background->isOpaque() &&
+      (!state->pen || state->pen->isOpaque())) {
+    int x0 = std::ceil(bounds.x), y0 = std::ceil(bounds.y);
+    int x1 = std::floor(bounds.x + bounds.w);
+    int y1 = std::floor(bounds.y + bounds.h);
+    if (x1 > x0 && y1 > y0) {
+      opaqueRectangle = {x0, y0, x1 - x0, y1 - y0};
+      bOpaque = true;
+    }
+  }
+
   // no outline or fill defined, therefore Display the pen is used.
   std::function<void(cairo_t * cr)> fnprolog;
   std::function<void(cairo_t * cr, AREA & a)> fnadjustForStroke;
   std::function<void(cairo_t * cr, AREA & a)> fn;
 
   // set the directly callable rendering function
-  if (background && pen) {
+  if (state->background && state->pen) {
     fnadjustForStroke = [=](cairo_t *cr, AREA &a) {
       a.shrink(cairo_get_line_width(cr) / 2);
     };
     fnprolog = [=](cairo_t *cr) {
-      background->emit(cr, bounds.x, bounds.y, bounds.w, bounds.h);
+      state->background->emit(cr, bounds.x, bounds.y, bounds.w, bounds.h);
       cairo_fill_preserve(cr);
-      pen->emit(cr);
+      state->pen->emit(cr);
       cairo_stroke(cr);
     };
-  } else if (pen) {
+  } else if (state->pen) {
     fnadjustForStroke = [=](cairo_t *cr, AREA &a) {
       a.shrink(cairo_get_line_width(cr) / 2);
     };
 
     fnprolog = [=](cairo_t *cr) {
-      pen->emit(cr);
+      state->pen->emit(cr);
       cairo_stroke(cr);
     };
   } else {
     fnadjustForStroke = [=](cairo_t *cr, AREA &a) {};
     fnprolog = [=](cairo_t *cr) {
-      background->emit(cr, bounds.x, bounds.y, bounds.w, bounds.h);
+      state->background->emit(cr, bounds.x, bounds.y, bounds.w, bounds.h);
       cairo_fill(cr);
     };
   }
@@ -740,14 +1237,29 @@ void uxdevice::DRAWAREA::invoke(DisplayContext &context) {
   auto fnCache = [=](DisplayContext &context) {
     if (bRenderBufferCached)
       return;
-    _buf = context.allocateBuffer(_inkRectangle.width, _inkRectangle.height);
 
-    AREA a = *area;
-    a.x = 0;
-    a.y = 0;
+    // the buffer is rendered aside and published with the draw functions
+    // under the lock, the render thread reads it while this runs.
+    DRAWBUFFER buf = {};
+
+    // equal areas elsewhere may have been rendered already.
+    if (!sharedBuffer(context, buf)) {
+      functorsLock(true);
+      if (generation != buildGeneration) {
+        functorsLock(false);
+        return;
+      }
+      buf = context.allocateBuffer(_inkRectangle.width, _inkRectangle.height);
 
-    fn(_buf.cr, a);
-    cairo_surface_flush(_buf.rendered);
+      AREA a = *area;
+      a.x = 0;
+      a.y = 0;
+
+      fn(buf.cr, a);
+      functorsLock(false);
+      cairo_surface_flush(buf.rendered);
+      shareBuffer(context, buf);
+    }
 
     auto drawfn = [=](DisplayContext &context) {
       DrawingOutput::invoke(context.cr);
@@ -764,10 +1276,16 @@ void uxdevice::DRAWAREA::invoke(DisplayContext &context) {
       cairo_fill(context.cr);
     };
     functorsLock(true);
+    if (generation != buildGeneration) {
+      functorsLock(false);
+      context.destroyBuffer(buf);
+      return;
+    }
+    _buf = buf;
     fnDraw = std::bind(drawfn, _1);
     fnDrawClipped = std::bind(fnClipping, _1);
-    functorsLock(false);
     bRenderBufferCached = true;
+    functorsLock(false);
   };
   fnCacheSurface = fnCache;
 
@@ -778,31 +1296,133 @@ void uxdevice::DRAWAREA::invoke(DisplayContext &context) {
     auto drawfn = [=](DisplayContext &context) {
       DrawingOutput::invoke(context.cr);
       fn(context.cr, *area);
-      evaluateCache(context);
     };
     auto fnClipping = [=](DisplayContext &context) {
+      cairo_save(context.cr);
       DrawingOutput::invoke(context.cr);
       cairo_rectangle(context.cr, _intersection.x, _intersection.y,
                       _intersection.width, _intersection.height);
       cairo_clip(context.cr);
       fn(context.cr, *area);
-      cairo_reset_clip(context.cr);
-      evaluateCache(context);
+      cairo_restore(context.cr);
     };
 
+    DRAWBUFFER buf = {};
     functorsLock(true);
     fnDraw = std::bind(drawfn, _1);
     fnDrawClipped = std::bind(fnClipping, _1);
-    functorsLock(false);
-
     if (bRenderBufferCached) {
-      context.destroyBuffer(_buf);
+      buf = _buf;
+      _buf = {};
       bRenderBufferCached = false;
     }
+    functorsLock(false);
+    context.destroyBuffer(buf);
   };
 
   fnBaseSurface = fnBase;
-  fnBaseSurface(context);
+  functorsLock(false);
+  fnBase(context);
 
   bprocessed = true;
 }
+
+/**
+\internal
+\brief applies a parameter unit and makes it the current one. The type
+is final so the call is bound directly.
+*/
+template <typename T>
+static void invokeParameter(const std::shared_ptr<uxdevice::DisplayUnit> &unit,
+                            uxdevice::DisplayContext &context) {
+  auto item = std::static_pointer_cast<T>(unit);
+  item->invoke(context);
+  context.setUnit(item);
+}
+
+/**
+\internal
+\brief applies a drawing object and collects it for the caller to add
+to the context.
+*/
+template <typename T>
+static void invokeDrawable(const std::shared_ptr<uxdevice::DisplayUnit> &unit,
+                           uxdevice::DisplayContext &context,
+                           uxdevice::DrawingOutputBatch &drawables) {
+  auto item = std::static_pointer_cast<T>(unit);
+  item->invoke(context);
+  drawables.emplace_back(item);
+}
+
+/**
+\internal
+\brief The routine applies a unit held in a display list to the context
+as its submission would have. The concrete type is selected by the tag,
+no virtual call or cast is made. Drawing objects are appended to the
+batch.
+*/
+void uxdevice::invokeUnit(const std::shared_ptr<DisplayUnit> &unit,
+                          DisplayContext &context,
+                          DrawingOutputBatch &drawables) {
+  switch (unit->tag) {
+  case unitType::none:
+    break;
+  case unitType::antialias:
+    invokeParameter<ANTIALIAS>(unit, context);
+    break;
+  case unitType::area:
+    invokeParameter<AREA>(unit, context);
+    break;
+  case unitType::text:
+    invokeParameter<STRING>(unit, context);
+    break;
+  case unitType::font:
+    invokeParameter<FONT>(unit, context);
+    break;
+  case unitType::pen:
+    invokeParameter<PEN>(unit, context);
+    break;
+  case unitType::background:
+    invokeParameter<BACKGROUND>(unit, context);
+    break;
+  case unitType::align:
+    invokeParameter<ALIGN>(unit, context);
+    break;
+  case unitType::event:
+    invokeParameter<EVENT>(unit, context);
+    break;
+  case unitType::textShadow:
+    invokeParameter<TEXTSHADOW>(unit, context);
+    break;
+  case unitType::textOutline:
+    invokeParameter<TEXTOUTLINE>(unit, context);
+    break;
+  case unitType::textFill:
+    invokeParameter<TEXTFILL>(unit, context);
+    break;
+  case unitType::image:
+    invokeParameter<IMAGE>(unit, context);
+    break;
+  case unitType::optionFunction:
+    static_cast<OPTION_FUNCTION &>(*unit).invoke(context);
+    break;
+  case unitType::clear:
+    static_cast<CLEARUNIT &>(*unit).invoke(context);
+    break;
+  case unitType::function:
+    static_cast<FUNCTION &>(*unit).invoke(context);
+    break;
+  case unitType::commands:
+    static_cast<COMMANDBUFFER &>(*unit).invoke(context);
+    break;
+  case unitType::drawText:
+    invokeDrawable<DRAWTEXT>(unit, context, drawables);
+    break;
+  case unitType::drawImage:
+    invokeDrawable<DRAWIMAGE>(unit, context, drawables);
+    break;
+  case unitType::drawArea:
+    invokeDrawable<DRAWAREA>(unit, context, drawables);
+    break;
+  }
+}
@@ -15,10 +15,40 @@
 namespace uxdevice {
 
 /**
-\brief base class for all display units. defaulted
-is the isOutput function. Drawing object should override
-this and return true. This enables the checking of the surface
-for errors after invocation.
+\internal
+\brief the closed set of display units. Parameter units, whose current
+value is held by the context, are listed first and the drawing objects
+last so that the kind of a unit is found by range.
+*/
+enum class unitType : std::uint8_t {
+  none,
+  antialias,
+  area,
+  text,
+  font,
+  pen,
+  background,
+  align,
+  event,
+  textShadow,
+  textOutline,
+  textFill,
+  image,
+  optionFunction,
+  clear,
+  function,
+  commands,
+  drawText,
+  drawImage,
+  drawArea
+};
+
+/**
+\brief base class for all display units. The tag names the concrete
+type of the unit, it is set when the unit is placed in a display list.
+Units are dispatched by switching on the tag rather than through
+casts. isOutput is true for drawing objects, this enables the checking
+of the surface for errors after invocation.
 
 */
 class DisplayUnit {
@@ -33,7 +63,10 @@ public:
   }
   DisplayUnit(const DisplayUnit &other) { *this = other; }
   virtual void invoke(DisplayContext &context) {}
-  virtual bool isOutput(void) { return false; }
+  bool isOutput(void) { return tag >= unitType::drawText; }
+  bool isParameter(void) {
+    return tag >= unitType::antialias && tag <= unitType::optionFunction;
+  }
   void error(const char *s) { _serror = s; }
   bool valid(void) { return _serror == nullptr; }
   bool isprocessed(void) { return bprocessed; }
@@ -41,6 +74,7 @@ public:
   bool bprocessed = false;
   bool viewportInked = false;
   const char *_serror = nullptr;
+  unitType tag = unitType::none;
 };
 
 /**
@@ -54,12 +88,7 @@ class DrawingOutput : public DisplayUnit {
 public:
   typedef DisplayContext::CairoRegion CairoRegion;
   DrawingOutput(){};
-  ~DrawingOutput() {
-    if (oncethread)
-      oncethread.reset();
-
-    DisplayContext::destroyBuffer(_buf);
-  }
+  ~DrawingOutput() { DisplayContext::destroyBuffer(_buf); }
   DrawingOutput &operator=(const DrawingOutput &other) {
     if (other._buf.rendered)
       _buf.rendered = cairo_surface_reference(other._buf.rendered);
@@ -72,8 +101,7 @@ public:
     fnCacheSurface = other.fnCacheSurface;
     fnBaseSurface = other.fnBaseSurface;
 
-    std::copy(other.options.begin(), other.options.end(),
-              std::back_inserter(options));
+    state = other.state;
     _inkRectangle = other._inkRectangle;
     intersection = other.intersection;
     _intersection = other._intersection;
@@ -92,8 +120,39 @@ public:
   cairo_rectangle_t *intersectionExtents(void) { return &_intersection; }
   void invoke(cairo_t *cr);
   void invoke(DisplayContext &context) {}
-  bool isOutput(void) { return true; }
+  virtual void build(DisplayContext &context) {}
+  virtual void adopt(DrawingOutput &other);
+  void releaseCache(DisplayContext &context);
+  std::size_t bufferKey(void);
+  bool sharedBuffer(DisplayContext &context, DRAWBUFFER &buf);
+  void shareBuffer(DisplayContext &context, DRAWBUFFER &buf);
   std::atomic<bool> bRenderBufferCached = false;
+
+  // visibility is changed through a drawable handle. hidden objects
+  // remain in the index but are skipped by the renderer. bOnscreen is
+  // set while the ink is within the viewport.
+  std::atomic<bool> bVisible = true;
+  bool bOnscreen = false;
+
+  // position within the viewport index. the rectangle is the ink area
+  // the object is listed under, the order is its drawing order.
+  bool bIndexed = false;
+  cairo_rectangle_int_t indexRectangle = cairo_rectangle_int_t();
+  std::uint64_t indexOrder = 0;
+  std::uint64_t indexStamp = 0;
+
+  // set when the object paints every pixel of the rectangle opaquely.
+  // objects drawn before it and hidden by it are not drawn.
+  bool bOpaque = false;
+  cairo_rectangle_int_t opaqueRectangle = cairo_rectangle_int_t();
+
+  // hash of the type and the parameters of the object. objects with
+  // the same hash produce the same rendering.
+  std::size_t contentHash = 0;
+  // hash of the rendering without the position. objects with the same
+  // hash and ink size draw the same pixels and share a rendered buffer.
+  // zero when the buffer is not shared.
+  std::size_t visualHash = 0;
   DRAWBUFFER _buf = {};
 
   // These functions switch the rendering apparatus from off
@@ -118,37 +177,60 @@ public:
   DrawLogic fnDraw = DrawLogic();
   DrawLogic fnDrawClipped = DrawLogic();
 
-  // measure processing time
-  std::chrono::system_clock::time_point lastRenderTime = {};
-  void evaluateCache(DisplayContext &context);
-  bool bFirstTimeRendered = true;
-  std::unique_ptr<std::thread> oncethread = nullptr;
-  CairoOptionFn options = {};
+  // draw statistics kept by the raster cache. the render time is an
+  // average in nanoseconds of the draws made without the buffer.
+  std::int64_t renderTime = 0;
+  std::size_t drawFrames = 0;
+  std::uint64_t lastDrawnFrame = 0;
+  bool bCacheTracked = false;
+  // time of the last draw, read by the memory accountant.
+  std::int64_t lastUse = 0;
+  // set while the buffer is being rendered by the worker pool.
+  std::atomic<bool> bCachePending = false;
+  // counts the builds, under the functors lock. a cache job of an earlier
+  // build finds it changed and leaves the new functions in place.
+  std::uint64_t buildGeneration = 0;
+  RenderStatePtr state = nullptr;
   cairo_rectangle_t _inkRectangle = cairo_rectangle_t();
   cairo_rectangle_int_t intersection = cairo_rectangle_int_t();
   cairo_rectangle_t _intersection = cairo_rectangle_t();
 };
 
-typedef std::function<void(void)> CLEAR_FUNCTION;
+enum class clearTarget : std::uint8_t { textOutline, textFill, textShadow };
 
-class CLEARUNIT : public DisplayUnit {
+/**
+\brief removes a text parameter from the current units.
+*/
+class CLEARUNIT final : public DisplayUnit {
 public:
-  CLEARUNIT(CLEAR_FUNCTION _fn) : fn(_fn) {}
+  static constexpr unitType unitTag = unitType::clear;
+  CLEARUNIT(clearTarget _target) : target(_target) {}
 
   CLEARUNIT &operator=(const CLEARUNIT &other) {
-    fn = other.fn;
+    target = other.target;
     return *this;
   }
   CLEARUNIT(const CLEARUNIT &other) { *this = other; }
   void invoke(DisplayContext &context) {
-    fn();
+    switch (target) {
+    case clearTarget::textOutline:
+      context.setUnit(std::shared_ptr<TEXTOUTLINE>());
+      break;
+    case clearTarget::textFill:
+      context.setUnit(std::shared_ptr<TEXTFILL>());
+      break;
+    case clearTarget::textShadow:
+      context.setUnit(std::shared_ptr<TEXTSHADOW>());
+      break;
+    }
     bprocessed = true;
   }
-  CLEAR_FUNCTION fn = {};
+  clearTarget target = clearTarget::textOutline;
 };
 
-class ANTIALIAS : public DisplayUnit {
+class ANTIALIAS final : public DisplayUnit {
 public:
+  static constexpr unitType unitTag = unitType::antialias;
   ANTIALIAS(antialias _antialias)
       : setting(static_cast<cairo_antialias_t>(_antialias)) {}
 
@@ -160,8 +242,9 @@ public:
   cairo_antialias_t setting;
 };
 
-class AREA : public DisplayUnit {
+class AREA final : public DisplayUnit {
 public:
+  static constexpr unitType unitTag = unitType::area;
   AREA(void) {}
   AREA(double _cx, double _cy, double _r)
       : x(_cx), y(_cy), w(_r), h(_r), rx(_r), type(areaType::circle) {}
@@ -178,25 +261,32 @@ public:
   AREA(double _x, double _y, double _w, double _h, double _rx, double _ry)
       : x(_x), y(_y), w(_w), h(_h), rx(_rx), ry(_ry),
         type(areaType::roundedRectangle) {}
+  AREA(areaType _type, double _x, double _y, double _w, double _h, double _rx,
+       double _ry)
+      : x(_x), y(_y), w(_w), h(_h), rx(_rx), ry(_ry), type(_type) {}
   ~AREA() {}
   AREA(const AREA &other) { *this = other; };
   void shrink(double dWidth);
+  std::size_t hash(void);
+  std::size_t shapeHash(void);
   double x = 0.0, y = 0.0, w = 0.0, h = 0.0, rx = -1, ry = -1;
   areaType type = areaType::none;
 
   void invoke(DisplayContext &context) { bprocessed = true; }
 };
 
-class STRING : public DisplayUnit {
+class STRING final : public DisplayUnit {
 public:
+  static constexpr unitType unitTag = unitType::text;
   STRING(const std::string &s) : data(s) {}
   ~STRING() {}
   std::string data;
   void invoke(DisplayContext &context) { bprocessed = true; }
 };
 
-class FONT : public DisplayUnit {
+class FONT final : public DisplayUnit {
 public:
+  static constexpr unitType unitTag = unitType::font;
   FONT(const std::string &s)
       : description(s), pointSize(DEFAULT_TEXTSIZE), bProvidedName(false),
         bProvidedSize(false), bProvidedDescription(true) {}
@@ -229,8 +319,9 @@ public:
   }
 };
 
-class PEN : public DisplayUnit, public Paint {
+class PEN final : public DisplayUnit, public Paint {
 public:
+  static constexpr unitType unitTag = unitType::pen;
   PEN(const Paint &c) : Paint(c) {}
   PEN(u_int32_t c) : Paint(c) {}
   PEN(double _r, double _g, double _b) : Paint(_r, _g, _b) {}
@@ -246,8 +337,9 @@ public:
   void invoke(DisplayContext &context) { bprocessed = true; }
 };
 
-class BACKGROUND : public DisplayUnit, public Paint {
+class BACKGROUND final : public DisplayUnit, public Paint {
 public:
+  static constexpr unitType unitTag = unitType::background;
   BACKGROUND(const Paint &c) : Paint(c) {}
   BACKGROUND(u_int32_t c) : Paint(c) {}
   BACKGROUND(double _r, double _g, double _b) : Paint(_r, _g, _b) {}
@@ -264,8 +356,9 @@ public:
   void invoke(DisplayContext &context) { bprocessed = true; }
 };
 
-class ALIGN : public DisplayUnit {
+class ALIGN final : public DisplayUnit {
 public:
+  static constexpr unitType unitTag = unitType::align;
   ALIGN(alignment _aln) : setting(_aln) {}
   ~ALIGN() {}
   void emit(PangoLayout *layout);
@@ -273,16 +366,18 @@ public:
   void invoke(DisplayContext &context) { bprocessed = true; }
 };
 
-class EVENT : public DisplayUnit {
+class EVENT final : public DisplayUnit {
 public:
+  static constexpr unitType unitTag = unitType::event;
   EVENT(eventHandler _eh) : fn(_eh){};
   ~EVENT() {}
   eventHandler fn;
   void invoke(DisplayContext &context) { bprocessed = true; }
 };
 
-class TEXTSHADOW : public DisplayUnit, public Paint {
+class TEXTSHADOW final : public DisplayUnit, public Paint {
 public:
+  static constexpr unitType unitTag = unitType::textShadow;
   TEXTSHADOW(const Paint &c, int r, double xOffset, double yOffset)
       : Paint(c), radius(r), x(xOffset), y(yOffset) {}
   TEXTSHADOW(u_int32_t c, int r, double xOffset, double yOffset)
@@ -315,8 +410,9 @@ public:
   double x = 1, y = 1;
 };
 
-class TEXTOUTLINE : public Paint, public DisplayUnit {
+class TEXTOUTLINE final : public Paint, public DisplayUnit {
 public:
+  static constexpr unitType unitTag = unitType::textOutline;
   TEXTOUTLINE(const Paint &c, double _lineWidth)
       : Paint(c), lineWidth(_lineWidth) {}
   TEXTOUTLINE(u_int32_t c, double _lineWidth)
@@ -351,8 +447,9 @@ public:
   double lineWidth = .5;
 };
 
-class TEXTFILL : public Paint, public DisplayUnit {
+class TEXTFILL final : public Paint, public DisplayUnit {
 public:
+  static constexpr unitType unitTag = unitType::textFill;
   TEXTFILL(const Paint &c) : Paint(c) {}
   TEXTFILL(u_int32_t c) : Paint(c) {}
   TEXTFILL(double _r, double _g, double _b) : Paint(_r, _g, _b) {}
@@ -370,8 +467,16 @@ public:
   void invoke(DisplayContext &context) { bprocessed = true; }
 };
 
-class IMAGE : public DisplayUnit {
+/**
+\brief an image read from a file or data. The image is decoded by the
+worker pool, drawing objects skip it until it is loaded. The memory
+accountant may release the decoded image, the next draw decodes it
+again.
+*/
+class IMAGE final : public DisplayUnit,
+                    public std::enable_shared_from_this<IMAGE> {
 public:
+  static constexpr unitType unitTag = unitType::image;
   IMAGE(const std::string &data) : _data(data) {}
   IMAGE(const IMAGE &other) { *this = other; }
   IMAGE &operator=(const IMAGE &other) {
@@ -379,35 +484,36 @@ public:
     return *this;
   }
   ~IMAGE() {
-    removethread();
     if (_image)
       cairo_surface_destroy(_image);
   }
 
-  void removethread(void) {
-    if (loadthread.get()) {
-      if (loadthread.get()->joinable()) {
-        loadthread.get()->join();
-      }
-      loadthread.reset();
-    }
-  }
   void invoke(DisplayContext &context);
+  void load(DisplayContext &context);
+  void reload(DisplayContext &context);
+  bool emit(cairo_t *cr, double x, double y);
+  std::size_t bytes(void);
+  void release(void);
   std::atomic<cairo_surface_t *>_image = nullptr;
-  std::unique_ptr<std::thread> loadthread = nullptr;
+  // time of the last draw, read by the memory accountant.
+  std::atomic<std::int64_t> lastUse = 0;
+  std::atomic<bool> bLoading = false;
+  std::atomic_flag lockImage = ATOMIC_FLAG_INIT;
+#define IMAGE_SPIN while (lockImage.test_and_set(std::memory_order_acquire))
+#define IMAGE_CLEAR lockImage.clear(std::memory_order_release)
   std::shared_ptr<AREA> area = nullptr;
   std::string _data = "";
   bool bIsSVG = false;
   std::atomic<bool> bLoaded = false;
 };
-class DRAWTEXT : public DrawingOutput {
+class DRAWTEXT final : public DrawingOutput {
 public:
+  static constexpr unitType unitTag = unitType::drawText;
   DRAWTEXT(void) : beginIndex(0), endIndex(0), bEntire(true) {}
   DRAWTEXT(std::size_t _b, std::size_t _e)
       : beginIndex(_b), endIndex(_e), bEntire(false) {}
   DRAWTEXT(const DRAWTEXT &other) = delete;
   DRAWTEXT &operator=(const DRAWTEXT &other) = delete;
-  bool isOutput(void) { return true; }
   ~DRAWTEXT() {
     if (shadowImage)
       cairo_surface_destroy(shadowImage);
@@ -421,6 +527,9 @@ public:
   bool setLayoutOptions(cairo_t *cr);
   void drawShadow(cairo_t *cr);
   void createShadow(void);
+  std::size_t shadowBytes(void);
+  void releaseShadow(void);
+  void destroyShadow(void);
 
   std::size_t beginIndex = 0;
   std::size_t endIndex = 0;
@@ -431,21 +540,18 @@ public:
   PangoRectangle ink_rect = PangoRectangle();
   PangoRectangle logical_rect = PangoRectangle();
 
-  // local parameter pointers
-  std::shared_ptr<PEN> pen = nullptr;
-  std::shared_ptr<TEXTOUTLINE> textoutline = nullptr;
-  std::shared_ptr<TEXTFILL> textfill = nullptr;
-  std::shared_ptr<TEXTSHADOW> textshadow = nullptr;
+  // local parameter pointers, the style is held by the render state
   std::shared_ptr<AREA> area = nullptr;
   std::shared_ptr<STRING> text = nullptr;
-  std::shared_ptr<FONT> font = nullptr;
-  std::shared_ptr<ALIGN> align = nullptr;
 
   void invoke(DisplayContext &context);
+  void build(DisplayContext &context);
+  void adopt(DrawingOutput &other);
 };
 
-class DRAWIMAGE : public DrawingOutput {
+class DRAWIMAGE final : public DrawingOutput {
 public:
+  static constexpr unitType unitTag = unitType::drawImage;
   DRAWIMAGE(const AREA &a) : src(a) { bEntire = false; }
   DRAWIMAGE(void) {}
   ~DRAWIMAGE() {  }
@@ -457,31 +563,31 @@ public:
   }
 
   void invoke(DisplayContext &context);
+  void build(DisplayContext &context);
 
-private:
-  AREA src = AREA();
   std::shared_ptr<AREA> area = nullptr;
   std::shared_ptr<IMAGE> image = nullptr;
 
+private:
+  AREA src = AREA();
   bool bEntire = true;
 };
 
-class DRAWAREA : public DrawingOutput {
+class DRAWAREA final : public DrawingOutput {
 public:
+  static constexpr unitType unitTag = unitType::drawArea;
   DRAWAREA() {}
   ~DRAWAREA() {}
   DRAWAREA(const DRAWAREA &other) { *this = other; }
   DRAWAREA &operator=(const DRAWAREA &other) {
     area = other.area;
-    background = other.background;
-    pen = other.pen;
+    state = other.state;
     return *this;
   }
 
   void invoke(DisplayContext &context);
+  void build(DisplayContext &context);
   std::shared_ptr<AREA> area = nullptr;
-  std::shared_ptr<BACKGROUND> background = nullptr;
-  std::shared_ptr<PEN> pen = nullptr;
 };
 
 /**
@@ -489,8 +595,9 @@ public:
 \brief call previously bound function with the cairo context.
 */
 typedef std::function<void(cairo_t *cr)> CAIRO_FUNCTION;
-class FUNCTION : public DisplayUnit {
+class FUNCTION final : public DisplayUnit {
 public:
+  static constexpr unitType unitTag = unitType::function;
   FUNCTION(CAIRO_FUNCTION _func) : func(_func) {}
   ~FUNCTION() {}
   void invoke(DisplayContext &context) {
@@ -502,13 +609,83 @@ private:
   CAIRO_FUNCTION func;
 };
 
+/**
+\internal
+\brief path and transform operations packed as an opcode followed by
+its double operands in a contiguous byte stream. Consecutive operations
+are appended to the same unit rather than each allocating a function
+object. The stream is replayed by a single interpreter loop.
+*/
+class COMMANDBUFFER final : public DisplayUnit {
+public:
+  static constexpr unitType unitTag = unitType::commands;
+  enum class opcode : std::uint8_t {
+    save,
+    restore,
+    translate,
+    rotate,
+    scale,
+    identity,
+    arc,
+    arcNegative,
+    curve,
+    relCurve,
+    line,
+    relLine,
+    move,
+    relMove,
+    rectangle
+  };
+
+  COMMANDBUFFER() {}
+  COMMANDBUFFER(const std::uint8_t *data, std::size_t n)
+      : stream(data, data + n) {}
+  ~COMMANDBUFFER() {}
+
+  template <typename... Args> void append(opcode op, Args... args) {
+    static_assert(sizeof...(Args) <= maxOperands);
+    const double operands[] = {0, static_cast<double>(args)...};
+    std::size_t offset = stream.size();
+    stream.resize(offset + 1 + sizeof...(Args) * sizeof(double));
+    stream[offset] = static_cast<std::uint8_t>(op);
+    std::memcpy(&stream[offset + 1], &operands[1],
+                sizeof...(Args) * sizeof(double));
+  }
+  void replay(cairo_t *cr);
+  static bool valid(const std::uint8_t *data, std::size_t n);
+  std::size_t size(void) { return stream.size(); }
+  const std::vector<std::uint8_t> &data(void) { return stream; }
+
+  void invoke(DisplayContext &context) {
+    replay(context.cr);
+    bprocessed = true;
+  }
+
+private:
+  static constexpr std::size_t maxOperands = 6;
+
+  // the number of operands of each opcode, indexed by the opcode.
+  static constexpr std::uint8_t operandCount[] = {0, 0, 2, 1, 2, 0, 5, 5,
+                                                  6, 6, 2, 2, 2, 2, 4};
+  static_assert(sizeof(operandCount) ==
+                static_cast<std::size_t>(opcode::rectangle) + 1);
+
+  std::vector<std::uint8_t> stream = {};
+};
+
 typedef std::function<void(cairo_t *cr)> CAIRO_OPTION;
-class OPTION_FUNCTION : public DisplayUnit {
+class OPTION_FUNCTION final
+    : public DisplayUnit,
+      public std::enable_shared_from_this<OPTION_FUNCTION> {
 public:
+  static constexpr unitType unitTag = unitType::optionFunction;
   OPTION_FUNCTION(CAIRO_OPTION _func) : fnOption(_func) {}
   ~OPTION_FUNCTION() {}
   void invoke(DisplayContext &context);
 
   CAIRO_OPTION fnOption;
 };
+
+void invokeUnit(const std::shared_ptr<DisplayUnit> &unit,
+                DisplayContext &context, DrawingOutputBatch &drawables);
 } // namespace uxdevice
@@ -0,0 +1,114 @@
+/**
+\file uxmemoryaccountant.cpp
+
+\author Anthony Matarazzo
+
+\date 5/12/20
+\version 1.0
+
+\brief The module counts the memory of the caches and releases the least
+recently used resources to remain within the budget.
+
+*/
+#include "uxdevice.hpp"
+
+/**
+\internal
+\brief The routine registers a resource. A resource is registered once
+for its owner, registering it again while the owner lives has no effect.
+*/
+void uxdevice::MemoryAccountant::track(const RESOURCE &r) {
+  std::shared_ptr<void> owner = r.owner.lock();
+  if (!owner)
+    return;
+
+  RESOURCES_SPIN;
+  auto it = resources.find(owner.get());
+  if (it == resources.end())
+    resources.emplace(owner.get(), r);
+  else if (it->second.owner.expired())
+    it->second = r;
+  RESOURCES_CLEAR;
+}
+
+/**
+\internal
+\brief requests a trim. The render thread releases the memory once the
+next frame is drawn. The most severe of several requests is used.
+*/
+void uxdevice::MemoryAccountant::trim(trimLevel level) {
+  if (!bTrim || level > pendingTrim)
+    pendingTrim = level;
+  bTrim = true;
+}
+
+/**
+\internal
+\brief The routine measures the memory of the caches and releases the
+least recently used resources until the total is within the budget, or
+within the fraction a pending trim leaves. Resources used by the frame
+just drawn are kept unless trimming, they would be built again at once.
+The measurement is made at most once per check interval. Called by the
+render thread after each frame.
+*/
+void uxdevice::MemoryAccountant::enforce(DisplayContext &context) {
+  std::int64_t t = now();
+  bool bTrimming = bTrim.exchange(false);
+  if (!bTrimming && t - lastCheck < checkInterval)
+    return;
+  lastCheck = t;
+
+  std::int64_t cutoff = bTrimming ? INT64_MAX : frameStart;
+  std::vector<CANDIDATE> candidates = {};
+  std::size_t total = context.rasterCache.bytes();
+  context.rasterCache.candidates(context, cutoff, candidates);
+
+  RESOURCES_SPIN;
+  for (auto it = resources.begin(); it != resources.end();) {
+    std::shared_ptr<void> owner = it->second.owner.lock();
+    if (!owner) {
+      it = resources.erase(it);
+      continue;
+    }
+    std::size_t b = it->second.bytes();
+    std::int64_t used = it->second.lastUse();
+    total += b;
+    if (b && used < cutoff)
+      candidates.emplace_back(CANDIDATE{used, b, owner, it->second.release});
+    it++;
+  }
+  RESOURCES_CLEAR;
+
+  std::size_t target = total;
+  if (byteBudget)
+    target = std::min<std::size_t>(target, byteBudget);
+  if (bTrimming) {
+    switch (pendingTrim) {
+    case trimLevel::moderate:
+      target = std::min(target, total / 2);
+      break;
+    case trimLevel::critical:
+      target = std::min(target, total / 4);
+      break;
+    case trimLevel::complete:
+      target = 0;
+      break;
+    }
+  }
+
+  if (total > target) {
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto &a, const auto &b) {
+                return a.lastUse < b.lastUse;
+              });
+    for (auto &c : candidates) {
+      if (total <= target)
+        break;
+      c.release();
+      total -= std::min(total, c.bytes);
+      releasedCount++;
+    }
+  }
+
+  usedBytes = total;
+}
@@ -0,0 +1,93 @@
+/**
+\author Anthony Matarazzo
+\file uxmemoryaccountant.hpp
+\date 5/12/20
+\version 1.0
+ \details The memory accountant. The memory held by the caches, the
+ rendered buffers of drawing objects, the blurred text shadows, the
+ decoded images and the images of paints, is counted against one budget.
+ When the budget is exceeded the least recently used are released across
+ all of the caches. A released resource is built again when it is next
+ drawn.
+
+*/
+#pragma once
+
+namespace uxdevice {
+
+class DisplayContext;
+
+/**
+\brief how much of the cached memory a trim releases. moderate releases
+half, critical three quarters and complete all that can be built again.
+*/
+enum class trimLevel : std::uint8_t { moderate, critical, complete };
+
+/**
+\internal
+\class MemoryAccountant
+\brief tracks the resources of the caches and enforces the budget. Each
+resource is registered with its owner and functions reporting its size
+and last use and releasing it. The owner is held weakly, resources of
+destroyed owners are forgotten. The rendered buffers are kept by the
+raster cache which supplies its own candidates. The budget is enforced
+by the render thread after each frame.
+*/
+class MemoryAccountant {
+public:
+  typedef struct _RESOURCE {
+    std::weak_ptr<void> owner = {};
+    std::function<std::size_t(void)> bytes = {};
+    std::function<std::int64_t(void)> lastUse = {};
+    std::function<void(void)> release = {};
+  } RESOURCE;
+
+  // a resource that may be released, the owner is held until it is.
+  typedef struct _CANDIDATE {
+    std::int64_t lastUse = 0;
+    std::size_t bytes = 0;
+    std::shared_ptr<void> owner = nullptr;
+    std::function<void(void)> release = {};
+  } CANDIDATE;
+
+  // nanoseconds between the measurements of the budget.
+  static constexpr std::int64_t checkInterval = 250000000;
+
+  MemoryAccountant() {}
+  MemoryAccountant(const MemoryAccountant &other) = delete;
+  MemoryAccountant &operator=(const MemoryAccountant &other) = delete;
+
+  static std::int64_t now(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void track(const RESOURCE &r);
+  void beginFrame(void) { frameStart = now(); }
+  void enforce(DisplayContext &context);
+  void trim(trimLevel level);
+  bool trimPending(void) { return bTrim; }
+
+  void budget(std::size_t bytes) { byteBudget = bytes; }
+  std::size_t budget(void) { return byteBudget; }
+  std::size_t bytes(void) { return usedBytes; }
+  std::size_t released(void) { return releasedCount; }
+
+private:
+  std::unordered_map<const void *, RESOURCE> resources = {};
+  std::atomic<std::size_t> byteBudget = 0;
+  std::atomic<std::size_t> usedBytes = 0;
+  std::atomic<std::size_t> releasedCount = 0;
+  std::atomic<bool> bTrim = false;
+  std::atomic<trimLevel> pendingTrim = trimLevel::moderate;
+  std::int64_t frameStart = 0;
+  std::int64_t lastCheck = 0;
+
+  std::atomic_flag lockResources = ATOMIC_FLAG_INIT;
+#define RESOURCES_SPIN                                                         \
+  while (lockResources.test_and_set(std::memory_order_acquire))
+#define RESOURCES_CLEAR lockResources.clear(std::memory_order_release)
+};
+
+} // namespace uxdevice
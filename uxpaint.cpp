@@ -109,6 +109,80 @@ uxdevice::Paint::Paint(double cx0, double cy0, double radius0, double cx1,
       _radius0(radius0), _cx1(cx1), _cy1(cy1), _radius1(radius1), _stops(cs),
       _bLoaded(false) {}
 
+/**
+\brief returns true when every pixel painted with the paint is opaque.
+Solid colors with full alpha and linear gradients whose stops are all
+opaque qualify. A description not yet loaded is tested as a color name,
+images are not treated as opaque.
+*/
+bool uxdevice::Paint::isOpaque(void) const {
+  if (_bLoaded && _type == paintType::color)
+    return _a >= 1.0;
+
+  if (_gradientType == gradientType::linear && !_stops.empty())
+    return std::all_of(_stops.begin(), _stops.end(), [](const auto &n) {
+      return !n._bRGBA || n._a >= 1.0;
+    });
+
+  if (!_bLoaded && !_description.empty() &&
+      _gradientType == gradientType::none) {
+    PangoColor c;
+    return pango_color_parse(&c, _description.data());
+  }
+
+  return false;
+}
+
+/**
+\brief The routine returns a hash of the paint as it was specified. The
+fields filled in when a description is loaded are not used so that a
+loaded paint and a new one from the same description compare equal.
+*/
+std::size_t uxdevice::Paint::hash(void) const {
+  std::size_t value = 0;
+
+  if (!_description.empty()) {
+    // an image is read at the requested size.
+    hashCombine(value, _description);
+    hashCombine(value, _width);
+    hashCombine(value, _height);
+    return value;
+  }
+
+  hashCombine(value, _gradientType);
+  switch (_gradientType) {
+  case gradientType::none:
+    hashCombine(value, _r);
+    hashCombine(value, _g);
+    hashCombine(value, _b);
+    hashCombine(value, _a);
+    break;
+  case gradientType::linear:
+    hashCombine(value, _x0);
+    hashCombine(value, _y0);
+    hashCombine(value, _x1);
+    hashCombine(value, _y1);
+    break;
+  case gradientType::radial:
+    hashCombine(value, _cx0);
+    hashCombine(value, _cy0);
+    hashCombine(value, _radius0);
+    hashCombine(value, _cx1);
+    hashCombine(value, _cy1);
+    hashCombine(value, _radius1);
+    break;
+  }
+
+  for (auto &cs : _stops) {
+    hashCombine(value, cs._offset);
+    hashCombine(value, cs._r);
+    hashCombine(value, cs._g);
+    hashCombine(value, cs._b);
+    hashCombine(value, cs._a);
+  }
+  return value;
+}
+
 uxdevice::Paint::~Paint() {
   if (_pattern)
     cairo_pattern_destroy(_pattern);
@@ -135,12 +209,12 @@ bool uxdevice::Paint::create(void) {
   // if a description was provided, determine how it should be interpreted
   _image = readImage(_description, _width, _height);
 
+  // the requested size is kept, it is part of the hash and an image that
+  // is released is read again at the same size.
   if (_image) {
-    _width = cairo_image_surface_get_width(_image);
-    _height = cairo_image_surface_get_height(_image);
     _pattern = cairo_pattern_create_for_surface(_image);
-    cairo_pattern_set_extend(_pattern, CAIRO_EXTEND_REPEAT);
-    cairo_pattern_set_filter(_pattern, CAIRO_FILTER_FAST);
+    cairo_pattern_set_extend(_pattern, static_cast<cairo_extend_t>(_extend));
+    cairo_pattern_set_filter(_pattern, static_cast<cairo_filter_t>(_filter));
     _type = paintType::pattern;
     _bLoaded = true;
 
@@ -306,8 +380,11 @@ the color name string.
 
 */
 void uxdevice::Paint::emit(cairo_t *cr) {
+  PAINT_SPIN;
   if (!isLoaded())
     create();
+  if (_image)
+    _lastUse = MemoryAccountant::now();
 
   if (isLoaded()) {
     switch (_type) {
@@ -330,17 +407,25 @@ void uxdevice::Paint::emit(cairo_t *cr) {
       break;
     }
   }
+  PAINT_CLEAR;
 }
 
 void uxdevice::Paint::emit(cairo_t *cr, double x, double y, double w,
                            double h) {
+  PAINT_SPIN;
   if (!isLoaded()) {
     create();
 
-    // adjust to user space
-    if (_type == paintType::pattern || _type == paintType::image)
+    // adjust to user space, once. a released image is created again
+    // with the matrix already placed.
+    if (!_bPlaced &&
+        (_type == paintType::pattern || _type == paintType::image)) {
       translate(-x, -y);
+      _bPlaced = true;
+    }
   }
+  if (_image)
+    _lastUse = MemoryAccountant::now();
 
   if (isLoaded()) {
     switch (_type) {
@@ -363,4 +448,34 @@ void uxdevice::Paint::emit(cairo_t *cr, double x, double y, double w,
       break;
     }
   }
+  PAINT_CLEAR;
+}
+
+/**
+\brief returns the bytes of the image of the paint, zero for colors and
+gradients.
+*/
+std::size_t uxdevice::Paint::imageBytes(void) {
+  PAINT_SPIN;
+  std::size_t ret = 0;
+  if (_image)
+    ret = cairo_image_surface_get_stride(_image) *
+          cairo_image_surface_get_height(_image);
+  PAINT_CLEAR;
+  return ret;
+}
+
+/**
+\brief releases the image of the paint. The image is read again when the
+paint is next emitted.
+*/
+void uxdevice::Paint::releaseImage(void) {
+  PAINT_SPIN;
+  if (_image) {
+    if (_pattern)
+      cairo_pattern_destroy(_pattern.exchange(nullptr));
+    cairo_surface_destroy(_image.exchange(nullptr));
+    _bLoaded = false;
+  }
+  PAINT_CLEAR;
 }
@@ -9,6 +9,16 @@
 #pragma once
 
 namespace uxdevice {
+
+/**
+\internal
+\brief combines the hash of a value into seed. Used to form the content
+hashes that compare drawing objects between frames.
+*/
+template <typename T> void hashCombine(std::size_t &seed, const T &v) {
+  seed ^= std::hash<T>{}(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
 /**
 \class Paint
 
@@ -97,22 +107,32 @@ public:
 
     _pangoColor = other._pangoColor;
     _bLoaded = other._bLoaded;
+    _bPlaced = other._bPlaced;
     return *this;
   }
   virtual ~Paint();
 
   virtual void emit(cairo_t *cr);
   virtual void emit(cairo_t *cr, double x, double y, double w, double h);
+  std::size_t hash(void) const;
+  bool isOpaque(void) const;
   void filter(filterType ft) {
+    _filter = ft;
     if (_pattern)
       cairo_pattern_set_filter(_pattern, static_cast<cairo_filter_t>(ft));
   }
   void extend(extendType et) {
+    _extend = et;
     if (_pattern)
       cairo_pattern_set_extend(_pattern, static_cast<cairo_extend_t>(et));
   }
 
+  std::size_t imageBytes(void);
+  void releaseImage(void);
+  std::int64_t lastUse(void) const { return _lastUse; }
+
 private:
+  friend class DisplayListSnapshot;
   bool create(void);
   bool isLoaded(void) const { return _bLoaded; }
   bool isLinearGradient(const std::string &s);
@@ -142,6 +162,19 @@ private:
   std::atomic<cairo_surface_t *>_image = nullptr;
   PangoColor _pangoColor = {0, 0, 0};
   bool _bLoaded = false;
+
+  // the pattern has been moved to the user space of the area.
+  bool _bPlaced = false;
+
+  // set by emit for paints of an image, the memory accountant releases
+  // the least recently used.
+  std::atomic<std::int64_t> _lastUse = 0;
+
+  // the image of a paint may be released by the render thread while
+  // another thread emits it.
+  std::atomic_flag lockPaint = ATOMIC_FLAG_INIT;
+#define PAINT_SPIN while (lockPaint.test_and_set(std::memory_order_acquire))
+#define PAINT_CLEAR lockPaint.clear(std::memory_order_release)
 };
 
 } // namespace uxdevice
@@ -0,0 +1,312 @@
+/**
+\file uxrastercache.cpp
+
+\author Anthony Matarazzo
+
+\date 5/12/20
+\version 1.0
+
+\brief The module promotes drawing objects to cached buffers and keeps
+the buffers within the memory budget.
+
+*/
+#include "uxdevice.hpp"
+
+/**
+\internal
+\brief The routine records a draw of the object and its time. Called by
+the renderers, possibly from several workers at once. Objects drawn from
+their buffer only have their use recorded.
+*/
+void uxdevice::RasterCache::drawn(const std::shared_ptr<DrawingOutput> &obj,
+                                  std::int64_t ns) {
+  RASTER_CACHE_SPIN;
+  if (obj->lastDrawnFrame != frame) {
+    if (!obj->bRenderBufferCached) {
+      if (frame - obj->lastDrawnFrame > frameWindow)
+        obj->drawFrames = 0;
+      obj->drawFrames++;
+      obj->renderTime =
+          obj->renderTime ? (obj->renderTime * 3 + ns) / 4 : ns;
+    }
+    obj->lastDrawnFrame = frame;
+    obj->lastUse = MemoryAccountant::now();
+    drawnObjects.emplace_back(obj);
+  }
+  RASTER_CACHE_CLEAR;
+}
+
+/**
+\internal
+\brief accounts for a buffer the object received from another, as when
+an object of the next frame takes over the rendering of the previous.
+*/
+void uxdevice::RasterCache::track(const std::shared_ptr<DrawingOutput> &obj) {
+  if (!obj->bRenderBufferCached || !obj->_buf.rendered)
+    return;
+
+  RASTER_CACHE_SPIN;
+  if (!obj->bCacheTracked) {
+    obj->bCacheTracked = true;
+    entries.emplace_back(ENTRY{obj, 0});
+  }
+  RASTER_CACHE_CLEAR;
+}
+
+/**
+\internal
+\brief The routine ends the frame for the cache. The objects drawn by the
+frame that qualify are queued to the worker pool to be rendered into
+buffers, those on screen first. The least recently drawn buffers are
+released to make room. Called by the render thread once the frame has
+been drawn.
+*/
+void uxdevice::RasterCache::evaluate(DisplayContext &context) {
+  std::vector<std::shared_ptr<DrawingOutput>> candidates = {};
+  std::vector<std::shared_ptr<DrawingOutput>> victims = {};
+  std::vector<std::shared_ptr<DrawingOutput>> promotions = {};
+  std::size_t rendered = 0;
+
+  RASTER_CACHE_SPIN;
+  candidates.swap(drawnObjects);
+  frame++;
+  reconcile();
+
+  for (auto &n : candidates) {
+    if (n->tag != unitType::drawText && n->tag != unitType::drawArea)
+      continue;
+
+    if (n->bCachePending)
+      continue;
+
+    if (n->bRenderBufferCached) {
+      if (n->_buf.rendered && !n->bCacheTracked) {
+        n->bCacheTracked = true;
+        entries.emplace_back(ENTRY{n, 0});
+      }
+      continue;
+    }
+
+    // a buffer of equal content is held, a reference costs nothing.
+    std::size_t key = n->bufferKey();
+    if (key && surfaces.count(key)) {
+      n->bCacheTracked = true;
+      n->bCachePending = true;
+      entries.emplace_back(ENTRY{n, 0});
+      promotions.emplace_back(n);
+      continue;
+    }
+
+    std::size_t need = (std::size_t)n->inkRectangle.width *
+                       n->inkRectangle.height * 4;
+    if (rendered == promotePerFrame || n->drawFrames < promoteDraws ||
+        n->renderTime < promoteTime || !need || need > byteBudget)
+      continue;
+
+    if (cachedBytes + need > byteBudget) {
+      evict(need, victims);
+      if (cachedBytes + need > byteBudget)
+        continue;
+    }
+
+    // the buffer is counted now, the entry is corrected by the next
+    // reconcile when it could not be created.
+    n->bCacheTracked = true;
+    n->bCachePending = true;
+    entries.emplace_back(ENTRY{n, need});
+    cachedBytes += need;
+    promotions.emplace_back(n);
+    rendered++;
+  }
+
+  if (cachedBytes > byteBudget)
+    evict(0, victims);
+  RASTER_CACHE_CLEAR;
+
+  // buffers are released and queued outside of the lock, the drawing
+  // functions are switched under the lock of each object. a promotion
+  // whose object is destroyed before it starts is dropped by the pool.
+  for (auto &n : victims)
+    n->releaseCache(context);
+  for (auto &n : promotions) {
+    DrawingOutput *p = n.get();
+    context.workerPool.submit(n->bOnscreen
+                                  ? WorkerPool::jobPriority::visible
+                                  : WorkerPool::jobPriority::offscreen,
+                              n, [=, &context]() {
+                                // the object may be rebuilt meanwhile.
+                                p->functorsLock(true);
+                                DrawLogic fn = p->fnCacheSurface;
+                                p->functorsLock(false);
+                                fn(context);
+                                p->bCachePending = false;
+                              });
+  }
+}
+
+/**
+\internal
+\brief forgets the objects. Called when the display context is cleared,
+the buffers are released with their objects.
+*/
+void uxdevice::RasterCache::clear(void) {
+  RASTER_CACHE_SPIN;
+  for (auto &e : entries)
+    if (auto n = e.obj.lock())
+      n->bCacheTracked = false;
+  entries.clear();
+  drawnObjects.clear();
+  cachedBytes = 0;
+  RASTER_CACHE_CLEAR;
+}
+
+/**
+\internal
+\brief The routine lists the buffers the memory accountant may release,
+those of objects last drawn before the cutoff. Buffers still being
+rendered are not listed. Releasing calls the object's base function on
+the render thread.
+*/
+void uxdevice::RasterCache::candidates(
+    DisplayContext &context, std::int64_t cutoff,
+    std::vector<MemoryAccountant::CANDIDATE> &list) {
+  RASTER_CACHE_SPIN;
+  for (auto &e : entries) {
+    auto n = e.obj.lock();
+    if (!n || n->bCachePending || n->lastUse >= cutoff)
+      continue;
+    DrawingOutput *p = n.get();
+    list.emplace_back(MemoryAccountant::CANDIDATE{
+        n->lastUse, e.bytes, n, [=, &context]() { p->releaseCache(context); }});
+  }
+  RASTER_CACHE_CLEAR;
+}
+
+/**
+\internal
+\brief returns a reference to the buffer held under the key, nullptr
+when there is none.
+*/
+cairo_surface_t *uxdevice::RasterCache::shared(std::size_t key) {
+  if (!key)
+    return nullptr;
+
+  cairo_surface_t *rendered = nullptr;
+  RASTER_CACHE_SPIN;
+  auto it = surfaces.find(key);
+  if (it != surfaces.end())
+    rendered = cairo_surface_reference(it->second);
+  RASTER_CACHE_CLEAR;
+  return rendered;
+}
+
+/**
+\internal
+\brief The routine holds the rendered buffer under the key. When a
+buffer is already held, as when equal objects were rendered at once, a
+reference to it is returned for the caller to use in place of its own.
+Otherwise returns nullptr.
+*/
+cairo_surface_t *uxdevice::RasterCache::share(std::size_t key,
+                                              cairo_surface_t *rendered) {
+  if (!key || !rendered)
+    return nullptr;
+
+  cairo_surface_t *held = nullptr;
+  RASTER_CACHE_SPIN;
+  auto it = surfaces.find(key);
+  if (it == surfaces.end())
+    surfaces.emplace(key, cairo_surface_reference(rendered));
+  else
+    held = cairo_surface_reference(it->second);
+  RASTER_CACHE_CLEAR;
+  return held;
+}
+
+/**
+\internal
+\brief The routine brings the entries up to date with their objects.
+Entries of objects that were destroyed, rebuilt or had their buffer
+released are removed, the sizes of the others are read from their
+buffers. A buffer shared by several objects is divided among them so
+that it is counted once. Objects whose buffer is still being rendered
+keep their estimate. Buffers held under a key that no object references
+any longer are released. The cache lock is held by the caller.
+*/
+void uxdevice::RasterCache::reconcile(void) {
+  std::unordered_map<cairo_surface_t *, std::size_t> users = {};
+
+  std::size_t i = 0;
+  while (i < entries.size()) {
+    auto n = entries[i].obj.lock();
+    entries[i].rendered = nullptr;
+    if (n && n->bCachePending) {
+      i++;
+      continue;
+    }
+    if (!n || !n->bRenderBufferCached || !n->_buf.rendered) {
+      if (n)
+        n->bCacheTracked = false;
+      entries[i] = std::move(entries.back());
+      entries.pop_back();
+      continue;
+    }
+    entries[i].rendered = n->_buf.rendered;
+    // pixmaps of the server are counted at four bytes a pixel.
+    if (cairo_surface_get_type(n->_buf.rendered) == CAIRO_SURFACE_TYPE_IMAGE)
+      entries[i].bytes = cairo_image_surface_get_stride(n->_buf.rendered) *
+                         cairo_image_surface_get_height(n->_buf.rendered);
+    else
+      entries[i].bytes =
+          (std::size_t)n->inkRectangle.width * n->inkRectangle.height * 4;
+    users[entries[i].rendered]++;
+    i++;
+  }
+
+  std::size_t total = 0;
+  for (auto &e : entries) {
+    if (e.rendered)
+      e.bytes /= users[e.rendered];
+    e.rendered = nullptr;
+    total += e.bytes;
+  }
+  cachedBytes = total;
+
+  for (auto it = surfaces.begin(); it != surfaces.end();) {
+    if (cairo_surface_get_reference_count(it->second) > 1) {
+      it++;
+      continue;
+    }
+    cairo_surface_destroy(it->second);
+    it = surfaces.erase(it);
+  }
+}
+
+/**
+\internal
+\brief The routine selects the least recently drawn buffers to release
+until need more bytes fit the budget. Buffers drawn by the current frame
+are kept. The selected objects are appended to victims and no longer
+counted. The cache lock is held by the caller.
+*/
+void uxdevice::RasterCache::evict(
+    std::size_t need, std::vector<std::shared_ptr<DrawingOutput>> &victims) {
+  std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+    auto pa = a.obj.lock(), pb = b.obj.lock();
+    return (pa ? pa->lastDrawnFrame : 0) < (pb ? pb->lastDrawnFrame : 0);
+  });
+
+  std::size_t i = 0;
+  while (i < entries.size() && cachedBytes + need > byteBudget) {
+    auto n = entries[i].obj.lock();
+    if (n && n->lastDrawnFrame + 1 >= frame)
+      break;
+    if (n) {
+      n->bCacheTracked = false;
+      victims.emplace_back(n);
+    }
+    cachedBytes -= std::min<std::size_t>(cachedBytes, entries[i].bytes);
+    i++;
+  }
+  entries.erase(entries.begin(), entries.begin() + i);
+}
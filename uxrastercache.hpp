@@ -0,0 +1,92 @@
+/**
+\author Anthony Matarazzo
+\file uxrastercache.hpp
+\date 5/12/20
+\version 1.0
+ \details The raster cache. Drawing objects that are redrawn often and
+ take long to draw are rendered once into a buffer of their own. Later
+ draws of the object copy the buffer. Objects that draw the same pixels,
+ wherever they are placed, share one buffer. The memory held by the
+ buffers is kept within a budget, the least recently drawn buffers are
+ released first.
+
+*/
+#pragma once
+
+namespace uxdevice {
+
+class DrawingOutput;
+class DisplayContext;
+
+/**
+\internal
+\class RasterCache
+\brief decides which drawing objects are drawn from a buffer. The
+renderers report each draw with its time. Once a frame is complete the
+render thread promotes the objects drawn in several recent frames whose
+draws are slow, and evicts buffers to remain within the budget. The
+buffers are rendered by the worker pool, buffers are released on the
+render thread. A rendered buffer is held under the key of its object
+while other objects reference it, an object with an equal key takes a
+reference rather than rendering its own. Such objects are cached
+without waiting to qualify.
+*/
+class RasterCache {
+public:
+  // an object drawn in this many frames, each within the window of
+  // frames of the previous, whose draw takes at least promoteTime
+  // nanoseconds is cached.
+  static constexpr std::size_t promoteDraws = 3;
+  static constexpr std::uint64_t frameWindow = 30;
+  static constexpr std::int64_t promoteTime = 50000;
+  // limits the buffers queued by one frame.
+  static constexpr std::size_t promotePerFrame = 8;
+
+  RasterCache() {}
+  ~RasterCache() {
+    for (auto &n : surfaces)
+      cairo_surface_destroy(n.second);
+  }
+  RasterCache(const RasterCache &other) = delete;
+  RasterCache &operator=(const RasterCache &other) = delete;
+
+  void drawn(const std::shared_ptr<DrawingOutput> &obj, std::int64_t ns);
+  void track(const std::shared_ptr<DrawingOutput> &obj);
+  void evaluate(DisplayContext &context);
+  void clear(void);
+  cairo_surface_t *shared(std::size_t key);
+  cairo_surface_t *share(std::size_t key, cairo_surface_t *rendered);
+  void candidates(DisplayContext &context, std::int64_t cutoff,
+                  std::vector<MemoryAccountant::CANDIDATE> &list);
+
+  void budget(std::size_t bytes) { byteBudget = bytes; }
+  std::size_t budget(void) { return byteBudget; }
+  std::size_t bytes(void) { return cachedBytes; }
+
+private:
+  typedef struct _ENTRY {
+    std::weak_ptr<DrawingOutput> obj = {};
+    std::size_t bytes = 0;
+    // the buffer of the object, valid within reconcile only.
+    cairo_surface_t *rendered = nullptr;
+  } ENTRY;
+
+  void reconcile(void);
+  void evict(std::size_t need,
+             std::vector<std::shared_ptr<DrawingOutput>> &victims);
+
+  std::vector<ENTRY> entries = {};
+  // rendered buffers by key, each holding a reference.
+  std::unordered_map<std::size_t, cairo_surface_t *> surfaces = {};
+  std::vector<std::shared_ptr<DrawingOutput>> drawnObjects = {};
+  std::uint64_t frame = 1;
+  std::atomic<std::size_t> byteBudget = 64 * 1024 * 1024;
+  std::atomic<std::size_t> cachedBytes = 0;
+
+  std::atomic_flag lockCache = ATOMIC_FLAG_INIT;
+#define RASTER_CACHE_SPIN                                                      \
+  while (lockCache.test_and_set(std::memory_order_acquire))
+#define RASTER_CACHE_CLEAR lockCache.clear(std::memory_order_release)
+};
+
+} // namespace uxdevice
@@ -0,0 +1,442 @@
+/**
+\file uxsnapshot.cpp
+
+\author Anthony Matarazzo
+
+\date 5/12/20
+\version 1.0
+
+\brief The module writes and maps binary snapshots of the display list.
+
+*/
+#include "uxdevice.hpp"
+
+static_assert(sizeof(uxdevice::SNAPSHOT_HEADER) % 8 == 0);
+static_assert(sizeof(uxdevice::SNAPSHOT_RECORD) % 8 == 0);
+static_assert(sizeof(uxdevice::SNAPSHOT_PAINT) % 8 == 0);
+static_assert(sizeof(uxdevice::SNAPSHOT_STOP) % 8 == 0);
+
+/**
+\internal
+\brief The routine appends a record describing the unit. Returns false
+for units that cannot be represented, these are the units holding
+functions.
+*/
+bool uxdevice::DisplayListSnapshot::add(DisplayUnit *unit) {
+  SNAPSHOT_RECORD r = SNAPSHOT_RECORD();
+
+  switch (unit->tag) {
+  case unitType::drawText:
+    r.type = snapshotUnit::drawText;
+    break;
+
+  case unitType::drawImage:
+    r.type = snapshotUnit::drawImage;
+    break;
+
+  case unitType::drawArea:
+    r.type = snapshotUnit::drawArea;
+    break;
+
+  case unitType::text: {
+    auto p = static_cast<STRING *>(unit);
+    r.type = snapshotUnit::text;
+    r.data = addData(p->data.data(), p->data.size());
+    r.size = p->data.size();
+  } break;
+
+  case unitType::area: {
+    auto p = static_cast<AREA *>(unit);
+    r.type = snapshotUnit::area;
+    r.setting = static_cast<std::uint8_t>(p->type);
+    r.d[0] = p->x;
+    r.d[1] = p->y;
+    r.d[2] = p->w;
+    r.d[3] = p->h;
+    r.d[4] = p->rx;
+    r.d[5] = p->ry;
+  } break;
+
+  case unitType::font: {
+    auto p = static_cast<FONT *>(unit);
+    r.type = snapshotUnit::font;
+    r.data = addData(p->description.data(), p->description.size());
+    r.size = p->description.size();
+  } break;
+
+  case unitType::pen:
+    r.type = snapshotUnit::pen;
+    r.paint = addPaint(*static_cast<PEN *>(unit));
+    break;
+
+  case unitType::background:
+    r.type = snapshotUnit::background;
+    r.paint = addPaint(*static_cast<BACKGROUND *>(unit));
+    break;
+
+  case unitType::textOutline: {
+    auto p = static_cast<TEXTOUTLINE *>(unit);
+    r.type = snapshotUnit::textOutline;
+    r.paint = addPaint(*p);
+    r.d[0] = p->lineWidth;
+  } break;
+
+  case unitType::textFill:
+    r.type = snapshotUnit::textFill;
+    r.paint = addPaint(*static_cast<TEXTFILL *>(unit));
+    break;
+
+  case unitType::textShadow: {
+    auto p = static_cast<TEXTSHADOW *>(unit);
+    r.type = snapshotUnit::textShadow;
+    r.paint = addPaint(*p);
+    r.d[0] = p->radius;
+    r.d[1] = p->x;
+    r.d[2] = p->y;
+  } break;
+
+  case unitType::align:
+    r.type = snapshotUnit::align;
+    r.setting = static_cast<std::uint8_t>(static_cast<ALIGN *>(unit)->setting);
+    break;
+
+  case unitType::antialias:
+    r.type = snapshotUnit::antialias;
+    r.setting =
+        static_cast<std::uint8_t>(static_cast<ANTIALIAS *>(unit)->setting);
+    break;
+
+  case unitType::image: {
+    auto p = static_cast<IMAGE *>(unit);
+    r.type = snapshotUnit::image;
+    r.data = addData(p->_data.data(), p->_data.size());
+    r.size = p->_data.size();
+  } break;
+
+  case unitType::commands: {
+    auto p = static_cast<COMMANDBUFFER *>(unit);
+    r.type = snapshotUnit::commands;
+    r.data = addData(p->data().data(), p->data().size());
+    r.size = p->data().size();
+  } break;
+
+  case unitType::clear:
+    r.type = snapshotUnit::clear;
+    r.setting =
+        static_cast<std::uint8_t>(static_cast<CLEARUNIT *>(unit)->target);
+    break;
+
+  default:
+    return false;
+  }
+
+  recordTable.emplace_back(r);
+  return true;
+}
+
+/**
+\internal
+\brief The routine stores the paint as it was specified. A description,
+which may name a color, an image or a gradient, is kept as text so that
+it is loaded again when first used.
+*/
+std::uint32_t uxdevice::DisplayListSnapshot::addPaint(const Paint &p) {
+  SNAPSHOT_PAINT sp = SNAPSHOT_PAINT();
+
+  if (!p._description.empty()) {
+    sp.type = snapshotPaint::description;
+    sp.description = addData(p._description.data(), p._description.size());
+    sp.descriptionSize = p._description.size();
+  } else if (p._gradientType == gradientType::linear) {
+    sp.type = snapshotPaint::linear;
+    sp.coordinates[0] = p._x0;
+    sp.coordinates[1] = p._y0;
+    sp.coordinates[2] = p._x1;
+    sp.coordinates[3] = p._y1;
+  } else if (p._gradientType == gradientType::radial) {
+    sp.type = snapshotPaint::radial;
+    sp.coordinates[0] = p._cx0;
+    sp.coordinates[1] = p._cy0;
+    sp.coordinates[2] = p._radius0;
+    sp.coordinates[3] = p._cx1;
+    sp.coordinates[4] = p._cy1;
+    sp.coordinates[5] = p._radius1;
+  } else {
+    sp.type = snapshotPaint::color;
+  }
+
+  sp.rgba[0] = p._r;
+  sp.rgba[1] = p._g;
+  sp.rgba[2] = p._b;
+  sp.rgba[3] = p._a;
+  sp.width = p._width;
+  sp.height = p._height;
+
+  sp.stop = stopTable.size();
+  sp.stopCount = p._stops.size();
+  for (auto &cs : p._stops)
+    stopTable.emplace_back(SNAPSHOT_STOP{cs._offset, cs._r, cs._g, cs._b, cs._a,
+                                         cs._bAutoOffset, cs._bRGBA, {}});
+
+  paintTable.emplace_back(sp);
+  return paintTable.size() - 1;
+}
+
+/**
+\internal
+\brief appends bytes to the data area and returns their offset.
+*/
+std::uint64_t uxdevice::DisplayListSnapshot::addData(const void *p,
+                                                     std::size_t size) {
+  std::uint64_t offset = dataTable.size();
+  dataTable.append(static_cast<const char *>(p), size);
+  return offset;
+}
+
+/**
+\internal
+\brief The routine writes the header and the tables. The tables are
+placed one after the other, each begins on an eight byte boundary as the
+structures are sized in multiples of eight.
+*/
+bool uxdevice::DisplayListSnapshot::write(const std::string &sFile) {
+  SNAPSHOT_HEADER h = SNAPSHOT_HEADER();
+  std::memcpy(h.magic, "UXDL", 4);
+  h.version = version;
+  h.recordSize = sizeof(SNAPSHOT_RECORD);
+  h.recordCount = recordTable.size();
+  h.paintCount = paintTable.size();
+  h.stopCount = stopTable.size();
+  h.recordOffset = sizeof(SNAPSHOT_HEADER);
+  h.paintOffset = h.recordOffset + h.recordCount * sizeof(SNAPSHOT_RECORD);
+  h.stopOffset = h.paintOffset + h.paintCount * sizeof(SNAPSHOT_PAINT);
+  h.dataOffset = h.stopOffset + h.stopCount * sizeof(SNAPSHOT_STOP);
+  h.dataSize = dataTable.size();
+
+  std::ofstream out(sFile, std::ios::binary | std::ios::trunc);
+  if (!out)
+    return false;
+
+  out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+  out.write(reinterpret_cast<const char *>(recordTable.data()),
+            recordTable.size() * sizeof(SNAPSHOT_RECORD));
+  out.write(reinterpret_cast<const char *>(paintTable.data()),
+            paintTable.size() * sizeof(SNAPSHOT_PAINT));
+  out.write(reinterpret_cast<const char *>(stopTable.data()),
+            stopTable.size() * sizeof(SNAPSHOT_STOP));
+  out.write(dataTable.data(), dataTable.size());
+
+  return out.good();
+}
+
+/**
+\internal
+\brief The routine maps the file and points the tables into the mapping.
+The header is checked so that every table lies within the file and is
+aligned, the tables are then validated. A file that fails is rejected.
+*/
+bool uxdevice::DisplayListSnapshot::map(const std::string &sFile) {
+  unmap();
+
+  int fd = open(sFile.data(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (std::size_t)st.st_size < sizeof(SNAPSHOT_HEADER)) {
+    close(fd);
+    return false;
+  }
+
+  void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return false;
+
+  mapped = p;
+  mappedSize = st.st_size;
+
+  const char *base = static_cast<const char *>(mapped);
+  const SNAPSHOT_HEADER *h = reinterpret_cast<const SNAPSHOT_HEADER *>(base);
+
+  auto within = [=](std::uint64_t offset, std::uint64_t count,
+                    std::uint64_t size) {
+    return offset <= mappedSize && count <= (mappedSize - offset) / size;
+  };
+
+  if (std::memcmp(h->magic, "UXDL", 4) != 0 || h->version != version ||
+      h->recordSize != sizeof(SNAPSHOT_RECORD) ||
+      h->recordOffset % 8 || h->paintOffset % 8 || h->stopOffset % 8 ||
+      !within(h->recordOffset, h->recordCount, sizeof(SNAPSHOT_RECORD)) ||
+      !within(h->paintOffset, h->paintCount, sizeof(SNAPSHOT_PAINT)) ||
+      !within(h->stopOffset, h->stopCount, sizeof(SNAPSHOT_STOP)) ||
+      !within(h->dataOffset, h->dataSize, 1)) {
+    unmap();
+    return false;
+  }
+
+  header = h;
+  records = reinterpret_cast<const SNAPSHOT_RECORD *>(base + h->recordOffset);
+  paints = reinterpret_cast<const SNAPSHOT_PAINT *>(base + h->paintOffset);
+  stops = reinterpret_cast<const SNAPSHOT_STOP *>(base + h->stopOffset);
+  dataArea = base + h->dataOffset;
+
+  if (!validate()) {
+    unmap();
+    return false;
+  }
+  return true;
+}
+
+/**
+\internal
+\brief The routine checks the contents of the mapped tables. The unit
+types and settings must be known values, paint and stop indexes and
+data ranges must lie within their tables and command streams must
+decode to the end of their data.
+*/
+bool uxdevice::DisplayListSnapshot::validate(void) {
+  auto inData = [=](std::uint64_t offset, std::uint64_t size) {
+    return offset <= header->dataSize && size <= header->dataSize - offset;
+  };
+
+  for (std::size_t i = 0; i < header->paintCount; i++) {
+    const SNAPSHOT_PAINT &sp = paints[i];
+    if (sp.type > snapshotPaint::radial || sp.stop > header->stopCount ||
+        sp.stopCount > header->stopCount - sp.stop)
+      return false;
+    if (sp.type == snapshotPaint::description &&
+        !inData(sp.description, sp.descriptionSize))
+      return false;
+  }
+
+  for (std::size_t i = 0; i < header->recordCount; i++) {
+    const SNAPSHOT_RECORD &r = records[i];
+    bool bValid = true;
+
+    switch (r.type) {
+    case snapshotUnit::text:
+    case snapshotUnit::font:
+    case snapshotUnit::image:
+      bValid = inData(r.data, r.size);
+      break;
+    case snapshotUnit::commands:
+      bValid = inData(r.data, r.size) &&
+               COMMANDBUFFER::valid(
+                   reinterpret_cast<const std::uint8_t *>(dataArea + r.data),
+                   r.size);
+      break;
+    case snapshotUnit::area:
+      bValid = r.setting <=
+               static_cast<std::uint8_t>(areaType::roundedRectangle);
+      break;
+    case snapshotUnit::pen:
+    case snapshotUnit::background:
+    case snapshotUnit::textOutline:
+    case snapshotUnit::textFill:
+    case snapshotUnit::textShadow:
+      bValid = r.paint < header->paintCount;
+      break;
+    case snapshotUnit::align:
+      switch (static_cast<alignment>(r.setting)) {
+      case alignment::left:
+      case alignment::center:
+      case alignment::right:
+      case alignment::justified:
+        break;
+      default:
+        bValid = false;
+        break;
+      }
+      break;
+    case snapshotUnit::antialias:
+      bValid = r.setting <= static_cast<std::uint8_t>(antialias::best);
+      break;
+    case snapshotUnit::clear:
+      bValid = r.setting <= static_cast<std::uint8_t>(clearTarget::textShadow);
+      break;
+    case snapshotUnit::drawText:
+    case snapshotUnit::drawImage:
+    case snapshotUnit::drawArea:
+      break;
+    default:
+      bValid = false;
+      break;
+    }
+
+    if (!bValid)
+      return false;
+  }
+
+  return true;
+}
+
+/**
+\internal
+\brief releases the mapping.
+*/
+void uxdevice::DisplayListSnapshot::unmap(void) {
+  if (mapped)
+    munmap(mapped, mappedSize);
+  mapped = nullptr;
+  mappedSize = 0;
+  header = nullptr;
+  records = nullptr;
+  paints = nullptr;
+  stops = nullptr;
+  dataArea = nullptr;
+}
+
+/**
+\internal
+\brief returns a view of the data area. A range outside of the area
+gives an empty view.
+*/
+std::string_view uxdevice::DisplayListSnapshot::data(std::uint64_t offset,
+                                                     std::uint64_t size) {
+  if (!header || offset > header->dataSize ||
+      size > header->dataSize - offset)
+    return std::string_view();
+  return std::string_view(dataArea + offset, size);
+}
+
+/**
+\internal
+\brief constructs the paint with the constructor that matches the way it
+was originally specified.
+*/
+uxdevice::Paint uxdevice::DisplayListSnapshot::paint(std::uint32_t idx) {
+  if (!header || idx >= header->paintCount)
+    return Paint(0, 0, 0);
+
+  const SNAPSHOT_PAINT &sp = paints[idx];
+
+  ColorStops cs = {};
+  if (sp.stop <= header->stopCount &&
+      sp.stopCount <= header->stopCount - sp.stop) {
+    for (std::size_t i = sp.stop; i < sp.stop + sp.stopCount; i++) {
+      const SNAPSHOT_STOP &s = stops[i];
+      ColorStop stop(s.offset, s.r, s.g, s.b, s.a);
+      stop._bAutoOffset = s.bAutoOffset;
+      stop._bRGBA = s.bRGBA;
+      cs.emplace_back(stop);
+    }
+  }
+
+  switch (sp.type) {
+  case snapshotPaint::description:
+    return Paint(std::string(data(sp.description, sp.descriptionSize)),
+                 sp.width, sp.height);
+  case snapshotPaint::linear:
+    return Paint(sp.coordinates[0], sp.coordinates[1], sp.coordinates[2],
+                 sp.coordinates[3], cs);
+  case snapshotPaint::radial:
+    return Paint(sp.coordinates[0], sp.coordinates[1], sp.coordinates[2],
+                 sp.coordinates[3], sp.coordinates[4], sp.coordinates[5], cs);
+  case snapshotPaint::color:
+    break;
+  }
+
+  return Paint(sp.rgba[0], sp.rgba[1], sp.rgba[2], sp.rgba[3]);
+}
@@ -0,0 +1,131 @@
+/**
+\author Anthony Matarazzo
+\file uxsnapshot.hpp
+\date 5/12/20
+\version 1.0
+ \details The binary snapshot of a display list. A snapshot is written as
+ a header followed by fixed size tables of records, paints and color
+ stops and finally a data area holding text, font descriptions, image
+ references and command streams. The file is mapped when read, the
+ tables are used in place without parsing. Units that hold functions,
+ such as stroke, fill or the line options, cannot be part of a snapshot,
+ a display list holding them is not written.
+
+*/
+#pragma once
+
+namespace uxdevice {
+
+enum class snapshotUnit : std::uint8_t {
+  text,
+  area,
+  font,
+  pen,
+  background,
+  textOutline,
+  textFill,
+  textShadow,
+  align,
+  antialias,
+  image,
+  commands,
+  clear,
+  drawText,
+  drawImage,
+  drawArea
+};
+
+enum class snapshotPaint : std::uint8_t { color, description, linear, radial };
+
+typedef struct _SNAPSHOT_HEADER {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t recordSize;
+  std::uint32_t recordCount;
+  std::uint32_t paintCount;
+  std::uint32_t stopCount;
+  std::uint64_t recordOffset;
+  std::uint64_t paintOffset;
+  std::uint64_t stopOffset;
+  std::uint64_t dataOffset;
+  std::uint64_t dataSize;
+} SNAPSHOT_HEADER;
+
+// setting holds the area type, alignment, antialias or clear target.
+// the meaning of the operands depends on the unit.
+typedef struct _SNAPSHOT_RECORD {
+  snapshotUnit type;
+  std::uint8_t setting;
+  std::uint16_t reserved;
+  std::uint32_t paint;
+  std::uint64_t data;
+  std::uint64_t size;
+  double d[6];
+} SNAPSHOT_RECORD;
+
+typedef struct _SNAPSHOT_PAINT {
+  snapshotPaint type;
+  std::uint8_t reserved[3];
+  std::uint32_t stopCount;
+  std::uint64_t stop;
+  std::uint64_t description;
+  std::uint64_t descriptionSize;
+  double rgba[4];
+  double coordinates[6];
+  double width;
+  double height;
+} SNAPSHOT_PAINT;
+
+typedef struct _SNAPSHOT_STOP {
+  double offset;
+  double r, g, b, a;
+  std::uint8_t bAutoOffset;
+  std::uint8_t bRGBA;
+  std::uint8_t reserved[6];
+} SNAPSHOT_STOP;
+
+/**
+\internal
+\class DisplayListSnapshot
+\brief builds the tables of a snapshot from display units and writes
+them, or maps a written file and provides access to its tables.
+*/
+class DisplayListSnapshot {
+public:
+  static constexpr std::uint32_t version = 1;
+
+  DisplayListSnapshot() {}
+  ~DisplayListSnapshot() { unmap(); }
+  DisplayListSnapshot(const DisplayListSnapshot &other) = delete;
+  DisplayListSnapshot &operator=(const DisplayListSnapshot &other) = delete;
+
+  bool add(DisplayUnit *unit);
+  bool write(const std::string &sFile);
+
+  bool map(const std::string &sFile);
+  void unmap(void);
+  std::size_t size(void) { return header ? header->recordCount : 0; }
+  const SNAPSHOT_RECORD &record(std::size_t idx) { return records[idx]; }
+  Paint paint(std::uint32_t idx);
+  std::string_view data(std::uint64_t offset, std::uint64_t size);
+
+private:
+  std::uint32_t addPaint(const Paint &p);
+  std::uint64_t addData(const void *p, std::size_t size);
+  bool validate(void);
+
+  std::vector<SNAPSHOT_RECORD> recordTable = {};
+  std::vector<SNAPSHOT_PAINT> paintTable = {};
+  std::vector<SNAPSHOT_STOP> stopTable = {};
+  std::string dataTable = {};
+
+  void *mapped = nullptr;
+  std::size_t mappedSize = 0;
+  const SNAPSHOT_HEADER *header = nullptr;
+  const SNAPSHOT_RECORD *records = nullptr;
+  const SNAPSHOT_PAINT *paints = nullptr;
+  const SNAPSHOT_STOP *stops = nullptr;
+  const char *dataArea = nullptr;
+};
+
+} // namespace uxdevice
@@ -0,0 +1,236 @@
+/**
+\file uxtilerenderer.cpp
+
+\author Anthony Matarazzo
+
+\date 5/12/20
+\version 1.0
+
+\brief The module renders the damage of a frame as tiles on worker
+threads.
+
+*/
+#include "uxdevice.hpp"
+
+/**
+\internal
+\brief The routine starts one worker per hardware thread. Each worker
+allocates its tile surface and points the cairo context of its own
+display context at it.
+*/
+void uxdevice::TileRenderer::start(void) {
+  std::size_t n = std::max(1u, std::thread::hardware_concurrency());
+
+  for (std::size_t i = 0; i < n; i++) {
+    auto w = std::make_unique<WORKER>();
+    w->surface =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, tileSize, tileSize);
+    w->context.cr = cairo_create(w->surface);
+    workers.emplace_back(std::move(w));
+  }
+
+  for (auto &w : workers) {
+    WORKER *p = w.get();
+    p->thread = std::thread([=]() { work(*p); });
+  }
+}
+
+/**
+\internal
+\brief stops the workers and releases their surfaces.
+*/
+void uxdevice::TileRenderer::stop(void) {
+  {
+    std::lock_guard<std::mutex> lk(mutexWork);
+    bStop = true;
+  }
+  cvWork.notify_all();
+
+  for (auto &w : workers) {
+    if (w->thread.joinable())
+      w->thread.join();
+    cairo_destroy(w->context.cr);
+    cairo_surface_destroy(w->surface);
+  }
+  workers.clear();
+}
+
+/**
+\internal
+\brief The routine is the worker thread. Each frame the worker takes
+tiles until none remain and reports when it is done.
+*/
+void uxdevice::TileRenderer::work(WORKER &w) {
+  std::uint64_t seen = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lk(mutexWork);
+      cvWork.wait(lk, [&]() { return bStop || generation != seen; });
+      if (bStop)
+        return;
+      seen = generation;
+    }
+
+    std::size_t i;
+    while ((i = nextTile.fetch_add(1)) < tiles.size())
+      renderTile(w, tiles[i]);
+
+    std::lock_guard<std::mutex> lk(mutexWork);
+    if (--busy == 0)
+      cvDone.notify_one();
+  }
+}
+
+/**
+\internal
+\brief The routine splits the damage into tiles, sorts the visible
+objects into the tiles their ink touches and renders the tiles on the
+workers. The objects keep their order within each tile. The damage is in
+document coordinates, x and y are the document position of the window.
+Returns when every tile has been composited to the window surface.
+*/
+void uxdevice::TileRenderer::render(DisplayContext &context,
+                                    cairo_region_t *damage, int x, int y) {
+  if (workers.empty())
+    start();
+
+  originX = x;
+  originY = y;
+
+  cairo_rectangle_int_t extents;
+  cairo_region_get_extents(damage, &extents);
+
+  int col0 = extents.x / tileSize;
+  int row0 = extents.y / tileSize;
+  int cols = (extents.x + extents.width - 1) / tileSize - col0 + 1;
+  int rows = (extents.y + extents.height - 1) / tileSize - row0 + 1;
+
+  // grid of the tiles holding damage, -1 where a tile has none.
+  std::vector<int> grid(cols * rows, -1);
+  tiles.clear();
+  for (int row = 0; row < rows; row++)
+    for (int col = 0; col < cols; col++) {
+      cairo_rectangle_int_t rect = {(col0 + col) * tileSize,
+                                    (row0 + row) * tileSize, tileSize,
+                                    tileSize};
+      cairo_region_t *tileDamage = cairo_region_create_rectangle(&rect);
+      cairo_region_intersect(tileDamage, damage);
+      if (cairo_region_is_empty(tileDamage)) {
+        cairo_region_destroy(tileDamage);
+        continue;
+      }
+      grid[row * cols + col] = tiles.size();
+      tiles.emplace_back(TILE{rect.x, rect.y, tileDamage, {}});
+    }
+
+  DrawingOutputBatch objects = {};
+  context.queryDrawables(extents, objects);
+
+  for (auto &n : objects) {
+    if (!n->bVisible || !n->hasInkExtents)
+      continue;
+    const cairo_rectangle_int_t &ink = n->inkRectangle;
+    int c0 = std::max(ink.x / tileSize - col0, 0);
+    int r0 = std::max(ink.y / tileSize - row0, 0);
+    int c1 = std::min((ink.x + ink.width - 1) / tileSize - col0, cols - 1);
+    int r1 = std::min((ink.y + ink.height - 1) / tileSize - row0, rows - 1);
+    for (int row = r0; row <= r1; row++)
+      for (int col = c0; col <= c1; col++)
+        if (grid[row * cols + col] >= 0)
+          tiles[grid[row * cols + col]].objects.emplace_back(n);
+  }
+
+  {
+    std::unique_lock<std::mutex> lk(mutexWork);
+    target = &context;
+    for (auto &w : workers)
+      w->context.owner = &context;
+    nextTile = 0;
+    busy = workers.size();
+    generation++;
+    cvWork.notify_all();
+    cvDone.wait(lk, [&]() { return busy == 0; });
+  }
+
+  for (auto &tile : tiles)
+    cairo_region_destroy(tile.damage);
+  tiles.clear();
+
+  for (auto &w : workers)
+    if (w->context.errorState())
+      context.errorState(__func__, __LINE__, __FILE__,
+                         w->context.errorText());
+}
+
+/**
+\internal
+\brief The routine paints the background and the objects of one tile
+into the worker's surface, clipped to the damage of the tile. The
+surface is translated so that objects draw in document coordinates. The
+tile is then composited to the window surface.
+*/
+void uxdevice::TileRenderer::renderTile(WORKER &w, TILE &tile) {
+  cairo_t *cr = w.context.cr;
+  DisplayContext &context = *target;
+  DisplayContext::CairoRegion region(tile.damage);
+
+  cairo_save(cr);
+  cairo_translate(cr, -tile.x, -tile.y);
+  for (int i = 0; i < cairo_region_num_rectangles(tile.damage); i++) {
+    cairo_rectangle_int_t rect;
+    cairo_region_get_rectangle(tile.damage, i, &rect);
+    cairo_rectangle(cr, rect.x, rect.y, rect.width, rect.height);
+  }
+  cairo_clip(cr);
+
+  while (context.lockBrush.test_and_set(std::memory_order_acquire))
+    ;
+  context.brush.emit(cr);
+  context.lockBrush.clear(std::memory_order_release);
+  cairo_paint(cr);
+
+  context.culledDraws += DisplayContext::cull(tile.objects, tile.damage);
+  for (auto &n : tile.objects) {
+    auto start = std::chrono::steady_clock::now();
+    // an object spanning tiles is intersected by several workers, the
+    // overlap of this tile is kept before the lock is released.
+    n->functorsLock(true);
+    n->intersect(region);
+    cairo_region_overlap_t overlap = n->overlap;
+    switch (overlap) {
+    case CAIRO_REGION_OVERLAP_OUT:
+      break;
+    case CAIRO_REGION_OVERLAP_IN:
+      n->fnDraw(w.context);
+      break;
+    case CAIRO_REGION_OVERLAP_PART:
+      n->fnDrawClipped(w.context);
+      break;
+    }
+    n->functorsLock(false);
+    if (overlap != CAIRO_REGION_OVERLAP_OUT)
+      context.rasterCache.drawn(
+          n, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now() - start)
+                 .count());
+    if (context.bClearFrame)
+      break;
+  }
+  cairo_restore(cr);
+  cairo_surface_flush(w.surface);
+
+  context.lock(true);
+  cairo_save(context.cr);
+  cairo_translate(context.cr, -originX, -originY);
+  for (int i = 0; i < cairo_region_num_rectangles(tile.damage); i++) {
+    cairo_rectangle_int_t rect;
+    cairo_region_get_rectangle(tile.damage, i, &rect);
+    cairo_rectangle(context.cr, rect.x, rect.y, rect.width, rect.height);
+  }
+  cairo_clip(context.cr);
+  cairo_set_source_surface(context.cr, w.surface, tile.x, tile.y);
+  cairo_paint(context.cr);
+  cairo_restore(context.cr);
+  context.lock(false);
+}
@@ -0,0 +1,73 @@
+/**
+\author Anthony Matarazzo
+\file uxtilerenderer.hpp
+\date 5/12/20
+\version 1.0
+ \details The tiled renderer. The damage of a frame is split into fixed
+ size tiles of the document. The drawing objects are sorted into the tiles
+ they touch and each tile is rendered by one of a set of worker threads
+ into an image surface of its own. A finished tile is composited to the
+ window surface. Objects are drawn under their own lock so an object
+ spanning tiles is drawn by one worker at a time.
+
+*/
+#pragma once
+
+namespace uxdevice {
+
+/**
+\internal
+\class TileRenderer
+\brief renders the damage of a frame in parallel. The workers are started
+on the first frame and live until the renderer is destroyed. Each worker
+keeps a tile sized surface and a context whose cairo context targets it,
+the drawing functions of the objects are called with that context. The
+context is owned by the one rendered, images reloaded and buffers shared
+by the draws use the pool and the raster cache of the owner.
+*/
+class TileRenderer {
+public:
+  static constexpr int tileSize = 128;
+
+  TileRenderer() {}
+  ~TileRenderer() { stop(); }
+  TileRenderer(const TileRenderer &other) = delete;
+  TileRenderer &operator=(const TileRenderer &other) = delete;
+
+  void render(DisplayContext &context, cairo_region_t *damage, int x, int y);
+
+private:
+  typedef struct _TILE {
+    int x = 0;
+    int y = 0;
+    cairo_region_t *damage = nullptr;
+    std::vector<std::shared_ptr<DrawingOutput>> objects = {};
+  } TILE;
+
+  typedef struct _WORKER {
+    std::thread thread = {};
+    DisplayContext context = {};
+    cairo_surface_t *surface = nullptr;
+  } WORKER;
+
+  void start(void);
+  void stop(void);
+  void work(WORKER &w);
+  void renderTile(WORKER &w, TILE &tile);
+
+  std::vector<std::unique_ptr<WORKER>> workers = {};
+  DisplayContext *target = nullptr;
+  int originX = 0;
+  int originY = 0;
+  std::vector<TILE> tiles = {};
+  std::atomic<std::size_t> nextTile = 0;
+
+  std::mutex mutexWork = {};
+  std::condition_variable cvWork = {};
+  std::condition_variable cvDone = {};
+  std::uint64_t generation = 0;
+  std::size_t busy = 0;
+  bool bStop = false;
+};
+
+} // namespace uxdevice
@@ -0,0 +1,98 @@
+/**
+\file uxworkerpool.cpp
+
+\author Anthony Matarazzo
+
+\date 5/12/20
+\version 1.0
+
+\brief The module runs background jobs on a fixed set of threads.
+
+*/
+#include "uxdevice.hpp"
+
+/**
+\internal
+\brief The routine starts the threads. The mutex is held by the caller.
+*/
+void uxdevice::WorkerPool::start(void) {
+  std::size_t n = std::min<std::size_t>(
+      maxWorkers, std::max(1u, std::thread::hardware_concurrency()));
+
+  for (std::size_t i = 0; i < n; i++)
+    threads.emplace_back([=]() { work(); });
+}
+
+/**
+\internal
+\brief stops the threads. Jobs that have not started are dropped, the
+running jobs are waited for.
+*/
+void uxdevice::WorkerPool::stop(void) {
+  {
+    std::lock_guard<std::mutex> lk(mutexJobs);
+    bStop = true;
+    jobs = {};
+  }
+  cvJobs.notify_all();
+
+  for (auto &t : threads)
+    if (t.joinable())
+      t.join();
+  threads.clear();
+}
+
+/**
+\internal
+\brief The routine queues a job for the owner. The function is called on
+one of the threads while the owner is held, it is not called when the
+owner no longer exists.
+*/
+void uxdevice::WorkerPool::submit(jobPriority priority,
+                                  std::weak_ptr<void> owner,
+                                  const std::function<void(void)> &fn) {
+  {
+    std::lock_guard<std::mutex> lk(mutexJobs);
+    if (bStop)
+      return;
+    if (threads.empty())
+      start();
+    jobs.emplace(JOB{priority, sequence++, std::move(owner), fn});
+  }
+  cvJobs.notify_one();
+}
+
+/**
+\internal
+\brief returns the number of jobs waiting for a thread.
+*/
+std::size_t uxdevice::WorkerPool::pending(void) {
+  std::lock_guard<std::mutex> lk(mutexJobs);
+  return jobs.size();
+}
+
+/**
+\internal
+\brief The routine is the thread. Jobs are taken in order, the owner is
+locked before the function is called and released once it returns.
+*/
+void uxdevice::WorkerPool::work(void) {
+  while (true) {
+    JOB job;
+    {
+      std::unique_lock<std::mutex> lk(mutexJobs);
+      cvJobs.wait(lk, [&]() { return bStop || !jobs.empty(); });
+      if (bStop)
+        return;
+      job = jobs.top();
+      jobs.pop();
+    }
+
+    std::shared_ptr<void> owner = job.owner.lock();
+    if (!owner) {
+      cancelledJobs++;
+      continue;
+    }
+    job.fn();
+  }
+}
@@ -0,0 +1,75 @@
+/**
+\author Anthony Matarazzo
+\file uxworkerpool.hpp
+\date 5/12/20
+\version 1.0
+ \details The worker pool. Work that is done away from the render thread,
+ the rendering of cache buffers, the decoding of images and the blurring
+ of text shadows, is queued as jobs to a fixed number of threads. Jobs
+ for objects on screen are taken before those for objects off screen.
+ Each job names the object it works for, a job whose object is destroyed
+ before the job starts is dropped.
+
+*/
+#pragma once
+
+namespace uxdevice {
+
+/**
+\internal
+\class WorkerPool
+\brief runs jobs on a fixed set of threads. The threads are started by
+the first submission and live until the pool is destroyed. The queue is
+ordered by priority and, within a priority, by submission. The owner of
+a job is held weakly while queued and strongly while the job runs.
+*/
+class WorkerPool {
+public:
+  enum class jobPriority : std::uint8_t { offscreen, visible };
+
+  // at most this many threads, the tile renderer shares the processors.
+  static constexpr std::size_t maxWorkers = 4;
+
+  WorkerPool() {}
+  ~WorkerPool() { stop(); }
+  WorkerPool(const WorkerPool &other) = delete;
+  WorkerPool &operator=(const WorkerPool &other) = delete;
+
+  void submit(jobPriority priority, std::weak_ptr<void> owner,
+              const std::function<void(void)> &fn);
+  void stop(void);
+
+  std::size_t pending(void);
+  std::size_t cancelled(void) { return cancelledJobs; }
+
+private:
+  typedef struct _JOB {
+    jobPriority priority = jobPriority::offscreen;
+    std::uint64_t sequence = 0;
+    std::weak_ptr<void> owner = {};
+    std::function<void(void)> fn = {};
+  } JOB;
+
+  // orders the heap so that the next job is at the top.
+  typedef struct _JOBORDER {
+    bool operator()(const JOB &a, const JOB &b) const {
+      if (a.priority != b.priority)
+        return a.priority < b.priority;
+      return a.sequence > b.sequence;
+    }
+  } JOBORDER;
+
+  void start(void);
+  void work(void);
+
+  std::vector<std::thread> threads = {};
+  std::priority_queue<JOB, std::vector<JOB>, JOBORDER> jobs = {};
+  std::uint64_t sequence = 0;
+  std::atomic<std::size_t> cancelledJobs = 0;
+
+  std::mutex mutexJobs = {};
+  std::condition_variable cvJobs = {};
+  bool bStop = false;
+};
+
+} // namespace uxdevice